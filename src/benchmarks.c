@@ -0,0 +1,369 @@
+/**
+ * Benchmarks for the LOB operations.
+ *
+ * Run with the --bench flag. Timings are wall clock, so run them on an
+ * otherwise idle machine.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "hftlob.h"
+
+
+long long
+benchNow(void){
+    /**
+     * Return a monotonic timestamp in nanoseconds.
+     */
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int
+openCacheMissCounter(void){
+    /**
+     * Open a counter of this thread's last level cache misses in user space,
+     * or return -1 if the kernel or machine does not provide one.
+     */
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+long long
+readCounter(int fd){
+    long long value = 0;
+    if(fd < 0 || read(fd, &value, sizeof(value)) != sizeof(value)){
+        return -1;
+    }
+    return value;
+}
+
+void
+BenchTrendingLimits(int window, int steps){
+    /**
+     * Add limits at ever higher prices while removing the oldest ones,
+     * which is the one-sided add/remove pattern of a trending market.
+     * Reports the mean and worst insert and remove latencies.
+     */
+    Limit *limits = malloc(window * sizeof(Limit));
+    Limit *ptr_root = createRoot();
+    long long start, elapsed;
+    long long insertTotal = 0, insertMax = 0, removeTotal = 0, removeMax = 0;
+    int i, slot;
+
+    for(i=0; i<steps; i++){
+        slot = i % window;
+        if(i >= window){
+            start = benchNow();
+            removeLimit(&limits[slot]);
+            elapsed = benchNow() - start;
+            removeTotal += elapsed;
+            removeMax = elapsed > removeMax ? elapsed : removeMax;
+        }
+        initLimit(&limits[slot]);
+        limits[slot].limitPrice = 100.0 + i;
+
+        start = benchNow();
+        addNewLimit(ptr_root, &limits[slot]);
+        elapsed = benchNow() - start;
+        insertTotal += elapsed;
+        insertMax = elapsed > insertMax ? elapsed : insertMax;
+    }
+
+    printf("trending limits (window %d, %d steps): insert mean %lld ns max %lld ns, "
+           "remove mean %lld ns max %lld ns, tree height %d\n",
+           window, steps, insertTotal / steps, insertMax,
+           removeTotal / (steps - window), removeMax, getHeight(ptr_root->rightChild));
+    free(ptr_root);
+    free(limits);
+}
+
+void
+BenchBookAddCancel(size_t ladderCapacity, int orderCount, int steps){
+    /**
+     * Add and cancel orders at random prices within 500 ticks of a slowly
+     * drifting mid price, as on a liquid instrument. Runs on a plain tree
+     * book if ladderCapacity is 0, and on a ladder book otherwise.
+     */
+    Book book;
+    Order *orders = malloc(orderCount * sizeof(Order));
+    long long start, elapsed;
+    int i, step;
+    int mid = 100000;
+    unsigned side;
+
+    initBook(&book);
+    reservePools(&book, 1024, 0, 0);
+    if(ladderCapacity > 0){
+        initLadders(&book, 1, ladderCapacity);
+    }
+    for(i=0; i<orderCount; i++){
+        initOrder(&orders[i]);
+    }
+    srand(1);
+    start = benchNow();
+    for(step=0; step<steps; step++){
+        i = rand() % orderCount;
+        if(orders[i].parentLimit != NULL){
+            cancelOrder(&book, &orders[i]);
+        }
+        else{
+            if(step % 64 == 0){
+                mid += rand() % 3 - 1;
+            }
+            side = rand() % 2 ? BUY : SELL;
+            orders[i].buyOrSell = side;
+            orders[i].limit = side == BUY ? mid - rand() % 500 : mid + 1 + rand() % 500;
+            orders[i].shares = 1 + rand() % 100;
+            addOrder(&book, &orders[i]);
+        }
+    }
+    elapsed = benchNow() - start;
+
+    printf("book add/cancel (%s, %d orders, %d steps): %lld ns per operation\n",
+           ladderCapacity > 0 ? "ladder" : "tree", orderCount, steps, elapsed / steps);
+    destroyBook(&book);
+    free(orders);
+}
+
+/* An order followed by its metadata, as Order was laid out before the split. */
+typedef struct MixedOrder{
+    Order order;
+    OrderMeta meta;
+} MixedOrder;
+
+void
+reportPhase(const char *layout, const char *phase, long long start, long long misses, int fd, int operations){
+    long long elapsed = benchNow() - start;
+    if(fd >= 0){
+        misses = readCounter(fd) - misses;
+        printf("cache misses (%s): %s %lld ns, %.2f misses per operation\n",
+               layout, phase, elapsed / operations, (double)misses / operations);
+    }
+    else{
+        printf("cache misses (%s): %s %lld ns, misses n/a\n", layout, phase, elapsed / operations);
+    }
+}
+
+void
+BenchOrderCacheMisses(int split, int orderCount){
+    /**
+     * Fill a deep book, then cancel half of its orders and execute a
+     * quarter in random order, reporting time and last level cache misses
+     * per add, cancel and execute.
+     *
+     * With split set the orders come from the book's pool, one cache line
+     * each with their metadata apart; otherwise each order is stored next to
+     * its metadata, as before the hot/cold split.
+     */
+    const char *layout = split ? "split" : "mixed";
+    Book book;
+    MixedOrder *mixed = NULL;
+    Order **orders = malloc(orderCount * sizeof(Order*));
+    int *shuffle = malloc(orderCount * sizeof(int));
+    int fd = openCacheMissCounter();
+    long long start, misses;
+    int i, j, tmp;
+
+    initBook(&book);
+    reservePools(&book, 4096, split ? orderCount : 0, 0);
+    if(!split){
+        mixed = malloc(orderCount * sizeof(MixedOrder));
+    }
+    srand(3);
+    for(i=0; i<orderCount; i++){
+        orders[i] = split ? allocateOrder(&book) : &mixed[i].order;
+        initOrder(orders[i]);
+        orders[i]->buyOrSell = i % 2 ? BUY : SELL;
+        orders[i]->limit = i % 2 ? 100000 - rand() % 1000 : 100001 + rand() % 1000;
+        orders[i]->shares = 1 + rand() % 100;
+        shuffle[i] = i;
+    }
+    for(i=orderCount-1; i>0; i--){
+        j = rand() % (i + 1);
+        tmp = shuffle[i];
+        shuffle[i] = shuffle[j];
+        shuffle[j] = tmp;
+    }
+    if(fd >= 0){
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+
+    misses = readCounter(fd);
+    start = benchNow();
+    for(i=0; i<orderCount; i++){
+        addOrder(&book, orders[shuffle[i]]);
+    }
+    reportPhase(layout, "add", start, misses, fd, orderCount);
+
+    misses = readCounter(fd);
+    start = benchNow();
+    for(i=0; i<orderCount/2; i++){
+        cancelOrder(&book, orders[shuffle[i]]);
+    }
+    reportPhase(layout, "cancel", start, misses, fd, orderCount / 2);
+
+    misses = readCounter(fd);
+    start = benchNow();
+    for(i=0; i<orderCount/4; i++){
+        executeOrder(&book, i % 2 ? BUY : SELL);
+    }
+    reportPhase(layout, "execute", start, misses, fd, orderCount / 4);
+
+    if(fd >= 0){
+        close(fd);
+    }
+    destroyBook(&book);
+    free(mixed);
+    free(orders);
+    free(shuffle);
+}
+
+void
+BenchApplyEvents(size_t batchSize, int orderCount, int steps){
+    /**
+     * Cancel random orders by id in a deep book and add them back by value
+     * at new prices, applying the events in batches of the given size.
+     */
+    Book book;
+    Event *events = malloc(2 * batchSize * sizeof(Event));
+    unsigned *sides = malloc(orderCount * sizeof(unsigned));
+    long long start, elapsed;
+    size_t failed = 0;
+    int i, step;
+    size_t e;
+
+    initBook(&book);
+    reservePools(&book, 4096, orderCount, 0);
+    reserveOrders(&book, orderCount);
+    srand(5);
+    for(i=0; i<orderCount; i++){
+        sides[i] = i % 2 ? BUY : SELL;
+        events[0].type = EVENT_ADD;
+        events[0].order = NULL;
+        events[0].id = i + 1;
+        events[0].buyOrSell = sides[i];
+        events[0].price = sides[i] == BUY ? 100000 - rand() % 1000 : 100001 + rand() % 1000;
+        events[0].shares = 1 + rand() % 100;
+        failed += applyEvents(&book, events, 1, NULL);
+    }
+
+    start = benchNow();
+    for(step=0; step<steps; step+=batchSize){
+        for(e=0; e<batchSize; e++){
+            i = rand() % orderCount;
+            events[e].type = EVENT_CANCEL;
+            events[e].id = i + 1;
+            events[e].order = NULL;
+            events[batchSize + e].type = EVENT_ADD;
+            events[batchSize + e].order = NULL;
+            events[batchSize + e].id = i + 1;
+            events[batchSize + e].buyOrSell = sides[i];
+            events[batchSize + e].price = sides[i] == BUY ? 100000 - rand() % 1000 : 100001 + rand() % 1000;
+            events[batchSize + e].shares = 1 + rand() % 100;
+        }
+        applyEvents(&book, events, batchSize, NULL);
+        applyEvents(&book, events + batchSize, batchSize, NULL);
+        /* An id drawn twice in a batch is only cancelled and added once. */
+        for(e=0; e<batchSize; e++){
+            if(events[e].result == 1 && events[batchSize + e].result != 1){
+                failed++;
+            }
+        }
+    }
+    elapsed = benchNow() - start;
+
+    printf("apply events (batches of %zu, %d orders): %lld ns per cancel and add, %zu failed\n",
+           batchSize, orderCount, elapsed / steps, failed);
+    destroyBook(&book);
+    free(events);
+    free(sides);
+}
+
+void
+BenchEngine(int workerCount, int instruments, int steps){
+    /**
+     * Submit random adds and cancels over many instruments from one thread
+     * to an engine with the given number of workers, and report the total
+     * throughput once all events are applied.
+     */
+    int perInstrument = 1024;
+    Order *orders = malloc((size_t)instruments * perInstrument * sizeof(Order));
+    char *resting = calloc((size_t)instruments * perInstrument, 1);
+    EngineConfig config;
+    Engine engine;
+    long long start, elapsed;
+    int i, step;
+
+    initEngineConfig(&config);
+    config.workerCount = workerCount;
+    config.waitPolicy = ENGINE_BUSY_POLL;
+    config.firstCpu = 1;
+    initEngine(&engine, &config, instruments);
+    srand(9);
+    for(i=0; i<instruments * perInstrument; i++){
+        initOrder(&orders[i]);
+        orders[i].id = i + 1;
+        orders[i].buyOrSell = i % 2 ? BUY : SELL;
+        orders[i].limit = i % 2 ? 10000 - rand() % 200 : 10001 + rand() % 200;
+        orders[i].shares = 1 + rand() % 100;
+    }
+    for(i=0; i<instruments; i++){
+        registerEngineInstrument(&engine, i, 1, 1, &ACTIVE_TIER);
+    }
+    startEngine(&engine);
+
+    start = benchNow();
+    for(step=0; step<steps; step++){
+        Event event;
+        i = rand() % (instruments * perInstrument);
+        event.type = resting[i] ? EVENT_CANCEL : EVENT_ADD;
+        event.instrument = i / perInstrument;
+        event.order = NULL;
+        event.id = orders[i].id;
+        event.buyOrSell = orders[i].buyOrSell;
+        event.price = orders[i].limit;
+        event.shares = orders[i].shares;
+        resting[i] = !resting[i];
+        while(!submitEngineEvent(&engine, &event)){
+        }
+    }
+    stopEngine(&engine);
+    elapsed = benchNow() - start;
+
+    printf("engine (%d workers, %d instruments): %.1f M events per second\n",
+           workerCount, instruments, steps * 1000.0 / elapsed);
+    destroyEngine(&engine);
+    free(orders);
+    free(resting);
+}
+
+void
+RunAllBenchmarks(void){
+    BenchTrendingLimits(1000, 1000000);
+    BenchTrendingLimits(100000, 1000000);
+    BenchBookAddCancel(0, 100000, 2000000);
+    BenchBookAddCancel(4096, 100000, 2000000);
+    BenchOrderCacheMisses(0, 1 << 20);
+    BenchOrderCacheMisses(1, 1 << 20);
+    BenchApplyEvents(1, 1 << 20, 1000000);
+    BenchApplyEvents(32, 1 << 20, 1000000);
+    BenchEngine(1, 64, 4000000);
+    BenchEngine(2, 64, 4000000);
+    BenchEngine(4, 64, 4000000);
+}
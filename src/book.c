@@ -0,0 +1,812 @@
+/**
+ * Book Operations
+ *
+ * A Book holds one limit tree per side and caches the inside of the book
+ * (Book.highestBuy and Book.lowestSell), so that GetBestBid/Offer is O(1).
+ * In ladder mode, the limits near the inside are kept in a Ladder per side
+ * instead, and the trees only hold the limits beyond the ladders' windows.
+ *
+ * All limits of a book, and optionally its orders, come from the book's
+ * pools, so that adding and removing limits does not call malloc once the
+ * pools are sized with reservePools().
+ */
+
+#include <math.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "hftlob.h"
+
+
+static void
+releaseToPool(Book *book, Pool *pool, void *object){
+    /**
+     * Free an object the book has unlinked, or retire it until readers are
+     * done with it if the book has an epoch domain.
+     */
+    if(book->epochs == NULL || !retireObject(book->epochs, pool, object)){
+        freeToPool(pool, object);
+    }
+}
+
+int
+limitIsBetter(unsigned buyOrSell, Price price, Limit *limit){
+    /**
+     * Check if the given price is nearer the inside than the given limit,
+     * or if there is no limit to compare against.
+     */
+    if(limit == NULL){
+        return 1;
+    }
+    if(buyOrSell == BUY){
+        return price > limit->limitPrice;
+    }
+    return price < limit->limitPrice;
+}
+
+void
+removeEmptyLimit(Book *book, Limit *limit, unsigned buyOrSell){
+    /**
+     * Remove an empty limit from its side of the book.
+     *
+     * If the limit is the inside of the book, the cached pointer is moved to
+     * the next best limit. In the tree this is the limit's in-order
+     * neighbour, one link away. In the ladder it is the next non-empty slot,
+     * found with a few scans of the ladder's occupancy bitmap, or the inside
+     * end of the tree if the window is empty.
+     */
+    Limit *tree = buyOrSell == BUY ? book->buyTree : book->sellTree;
+    Ladder *ladder = buyOrSell == BUY ? book->buyLadder : book->sellLadder;
+    Limit **inside = buyOrSell == BUY ? &book->highestBuy : &book->lowestSell;
+
+    if(ladder != NULL && ladderContains(ladder, limit)){
+        Limit *next = NULL;
+        if(limit == *inside){
+            next = getNextLadderLimit(ladder, limit, buyOrSell);
+        }
+        vacateLadderSlot(ladder, limit);
+        if(limit == *inside){
+            *inside = next;
+            if(*inside == NULL){
+                *inside = buyOrSell == BUY ? getPredecessor(tree) : getSuccessor(tree);
+            }
+            if(*inside != NULL && !ladderCoversInside(ladder, buyOrSell, (*inside)->limitPrice)){
+                /*If the window cannot move, the inside stays in the tree
+                 *and the next order moving the inside tries again.*/
+                recenterBookSide(book, buyOrSell, (*inside)->limitPrice);
+            }
+        }
+        return;
+    }
+
+    if(limit == *inside){
+        *inside = buyOrSell == BUY ? getPredecessor(limit) : getSuccessor(limit);
+    }
+    removeLimit(limit);
+    releaseToPool(book, &book->limitPool, limit);
+}
+
+static void
+adjustRangeTotals(Book *book, Limit *limit, Quantity shares){
+    /**
+     * Carry a change of the limit's size by the given shares up the subtree
+     * totals, if the book keeps them for range queries.
+     */
+    if(book->rangeTotals){
+        adjustSubtreeTotals(limit, shares, shares * limit->limitPrice);
+    }
+}
+
+static void
+noteLimitChange(Book *book, unsigned buyOrSell, Price price, Limit *limit){
+    /**
+     * Bring the book's depth and snapshot up to date after the limit at
+     * the given price changed; limit is NULL if it has been removed.
+     */
+    updateBookDepth(book, buyOrSell, price, limit);
+    if(book->snapshot != NULL){
+        noteSnapshotChange(book, buyOrSell, price);
+    }
+}
+
+static int
+queueOrder(Book *book, Order *order){
+    /**
+     * Queue an order at its limit, creating the limit if it does not exist
+     * yet. Leaves the order id index untouched.
+     */
+    Limit *tree;
+    Ladder *ladder;
+    Limit **inside;
+    if(order->buyOrSell == BUY){
+        tree = book->buyTree;
+        ladder = book->buyLadder;
+        inside = &book->highestBuy;
+    }
+    else if(order->buyOrSell == SELL){
+        tree = book->sellTree;
+        ladder = book->sellLadder;
+        inside = &book->lowestSell;
+    }
+    else{
+        return 0;
+    }
+
+    Limit *limit = NULL;
+    if(ladder != NULL){
+        if(!snapToLadderGrid(ladder, &order->limit)){
+            return 0;
+        }
+        if(limitIsBetter(order->buyOrSell, order->limit, *inside)
+           && !ladderCoversInside(ladder, order->buyOrSell, order->limit)){
+            /*The order moves the inside out of the window's sweet spot.*/
+            if(!recenterBookSide(book, order->buyOrSell, order->limit)){
+                return 0;
+            }
+        }
+        limit = getLadderLimit(ladder, order->limit);
+        if(limit != NULL && limit->headOrder == NULL){
+            occupyLadderSlot(ladder, limit, order->limit);
+        }
+    }
+    if(limit == NULL){
+        limit = findLimit(tree, order->limit);
+    }
+    if(limit == NULL){
+        limit = allocFromPool(&book->limitPool);
+        if(limit == NULL){
+            return 0;
+        }
+        initLimit(limit);
+        limit->limitPrice = order->limit;
+        if(!addNewLimit(tree, limit)){
+            /* Only prices which compare unequal to every limit, like NaN, get here. */
+            freeToPool(&book->limitPool, limit);
+            return 0;
+        }
+    }
+    if(limitIsBetter(order->buyOrSell, limit->limitPrice, *inside)){
+        *inside = limit;
+    }
+    if(!pushOrder(limit, order)){
+        return 0;
+    }
+    adjustRangeTotals(book, limit, order->shares);
+    noteLimitChange(book, order->buyOrSell, limit->limitPrice, limit);
+    return 1;
+}
+
+static int
+unqueueOrder(Book *book, Order *order){
+    /**
+     * Take a queued order out of its limit, removing the limit if it was
+     * the last order there. Leaves the order id index untouched.
+     */
+    Limit *limit = order->parentLimit;
+    if(removeOrder(order) != 1){
+        return -1;
+    }
+    adjustRangeTotals(book, limit, -order->shares);
+    order->parentLimit = NULL;
+    if(book->epochs == NULL){
+        /* Otherwise readers may still stand on the order and need its link. */
+        order->nextOrder = NULL;
+    }
+    order->prevOrder = NULL;
+
+    Price price = limit->limitPrice;
+    if(limit->headOrder == NULL){
+        removeEmptyLimit(book, limit, order->buyOrSell);
+        limit = NULL;
+    }
+    noteLimitChange(book, order->buyOrSell, price, limit);
+    return 1;
+}
+
+int
+addOrder(Book *book, Order *order){
+    /**
+     * Add an order to the book, creating its limit if it does not exist yet.
+     *
+     * O(log M) for the first order at a limit, O(1) for all others and for
+     * all limits inside the ladder's window.
+     *
+     * In ladder mode the price must be a whole number of ticks; orders at
+     * other prices are rejected, see snapToLadderGrid().
+     */
+    if(order->buyOrSell != BUY && order->buyOrSell != SELL){
+        return 0;
+    }
+    if(book->orders.slots != NULL && !insertIntoOrderMap(&book->orders, order)){
+        return 0;
+    }
+    if(!queueOrder(book, order)){
+        if(book->orders.slots != NULL){
+            removeFromOrderMap(&book->orders, order->id);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+int
+cancelOrder(Book *book, Order *order){
+    /**
+     * Remove an order from anywhere in the book, removing its limit
+     * if it was the last order there.
+     */
+    Limit *limit = order->parentLimit;
+    if(limit == NULL){
+        return 0;
+    }
+    if(unqueueOrder(book, order) != 1){
+        return -1;
+    }
+    if(book->orders.slots != NULL){
+        removeFromOrderMap(&book->orders, order->id);
+    }
+    return 1;
+}
+
+static int
+requeueFreshOrder(Book *book, Order *order, Price price, Quantity shares){
+    /**
+     * Move the order to a new price as a fresh order from allocateOrder(),
+     * for books with an epoch domain: readers may still stand on the order,
+     * and linking it into another queue would lead them to the wrong
+     * price. The given order leaves the book like a cancelled one, keeping
+     * its links, and the id index and metadata move to the fresh order.
+     */
+    Order *fresh = allocateOrder(book);
+    if(fresh == NULL){
+        return 0;
+    }
+    OrderMeta *meta = getOrderMeta(book, order);
+    if(meta != NULL){
+        *getOrderMeta(book, fresh) = *meta;
+    }
+    fresh->id = order->id;
+    fresh->buyOrSell = order->buyOrSell;
+    fresh->fromEvent = order->fromEvent;
+    fresh->limit = price;
+    fresh->shares = shares;
+    if(unqueueOrder(book, order) != 1){
+        releaseOrder(book, fresh);
+        return -1;
+    }
+    if(book->orders.slots != NULL){
+        removeFromOrderMap(&book->orders, order->id);
+    }
+    if(!queueOrder(book, fresh)){
+        releaseOrder(book, fresh);
+        return 0;
+    }
+    if(book->orders.slots != NULL){
+        insertIntoOrderMap(&book->orders, fresh);
+    }
+    return 1;
+}
+
+int
+modifyOrder(Book *book, Order *order, Price price, Quantity shares){
+    /**
+     * Change the price and size of an order in the book.
+     *
+     * A size reduction at the same price is done in place and keeps the
+     * order's queue position. A size increase moves the order to the back
+     * of its limit's queue, keeping the limit; a price change moves it to
+     * the back of the queue at the new price, reusing that limit if it
+     * exists. The order does not match against the book at its new price;
+     * cancel it and use submitOrder() for an aggressive replace.
+     *
+     * With an epoch domain attached, a price change queues a fresh order
+     * from allocateOrder() under the same id instead, found again with
+     * getOrderById(), and the given order leaves the book; release it like
+     * a cancelled one. If no fresh order can be allocated, 0 is returned
+     * with the order left where it was.
+     *
+     * Returns 0 if the order is not in the book or the new size is not
+     * positive, and if the order could not be queued at its new price, in
+     * which case it has been removed from the book. Returns -1 if the
+     * order's queue links are inconsistent.
+     */
+    if(order->parentLimit == NULL || shares <= 0){
+        return 0;
+    }
+    if(price == order->limit){
+        Limit *limit = order->parentLimit;
+        if(shares == order->shares){
+            return 1;
+        }
+        Quantity change = shares - order->shares;
+        if(shares < order->shares){
+            reduceOrder(order, order->shares - shares);
+        }
+        else{
+            if(removeOrder(order) != 1){
+                return -1;
+            }
+            order->shares = shares;
+            pushOrder(limit, order);
+        }
+        adjustRangeTotals(book, limit, change);
+        noteLimitChange(book, order->buyOrSell, price, limit);
+        return 1;
+    }
+
+    /*Publish the snapshot once for the move, not for each half of it.*/
+    BookSnapshot *snapshot = book->snapshot;
+    Price oldPrice = order->limit;
+    int result = 1;
+    book->snapshot = NULL;
+    if(book->epochs != NULL){
+        result = requeueFreshOrder(book, order, price, shares);
+    }
+    else if(unqueueOrder(book, order) != 1){
+        result = -1;
+    }
+    else{
+        order->limit = price;
+        order->shares = shares;
+        if(!queueOrder(book, order)){
+            if(book->orders.slots != NULL){
+                removeFromOrderMap(&book->orders, order->id);
+            }
+            result = 0;
+        }
+    }
+    book->snapshot = snapshot;
+    if(snapshot != NULL && !noteSnapshotChange(book, order->buyOrSell, price)){
+        noteSnapshotChange(book, order->buyOrSell, oldPrice);
+    }
+    return result;
+}
+
+Order*
+executeOrder(Book *book, unsigned buyOrSell){
+    /**
+     * Remove and return the oldest order at the inside of the given
+     * side of the book, or NULL if that side is empty.
+     */
+    Limit *limit = buyOrSell == BUY ? book->highestBuy : book->lowestSell;
+    if(limit == NULL){
+        return NULL;
+    }
+    Order *ptr_order = popOrder(limit);
+    adjustRangeTotals(book, limit, -ptr_order->shares);
+    ptr_order->parentLimit = NULL;
+    ptr_order->prevOrder = NULL;
+    if(book->orders.slots != NULL){
+        removeFromOrderMap(&book->orders, ptr_order->id);
+    }
+
+    Price price = limit->limitPrice;
+    if(limit->headOrder == NULL){
+        removeEmptyLimit(book, limit, buyOrSell);
+        limit = NULL;
+    }
+    noteLimitChange(book, buyOrSell, price, limit);
+    return ptr_order;
+}
+
+int
+reserveOrders(Book *book, size_t expectedOrders){
+    /**
+     * Enable the book's order id index, sized for the given number of
+     * resting orders. Must be called while the book is empty.
+     *
+     * The index does not grow on its own, so that adding an order never
+     * triggers a rehash; addOrder fails once it is full.
+     */
+    if(book->highestBuy != NULL || book->lowestSell != NULL){
+        return 0;
+    }
+    if(book->orders.slots != NULL){
+        destroyOrderMap(&book->orders);
+    }
+    return initOrderMap(&book->orders, expectedOrders);
+}
+
+Order*
+getOrderById(Book *book, uint64_t id){
+    if(book->orders.slots == NULL){
+        return NULL;
+    }
+    return getFromOrderMap(&book->orders, id);
+}
+
+Order*
+cancelOrderById(Book *book, uint64_t id){
+    /**
+     * Cancel the order with the given id and return it, or NULL if
+     * there is no such order in the book.
+     */
+    Order *ptr_order = getOrderById(book, id);
+    if(ptr_order == NULL || cancelOrder(book, ptr_order) != 1){
+        return NULL;
+    }
+    return ptr_order;
+}
+
+int
+executeOrderShares(Book *book, Order *order, Quantity shares){
+    /**
+     * Execute the given number of shares of the given order.
+     *
+     * The order keeps its queue position if it is only partially filled
+     * and is removed from the book otherwise.
+     */
+    if(order->parentLimit == NULL){
+        return 0;
+    }
+    if(shares < order->shares){
+        if(!reduceOrder(order, shares)){
+            return 0;
+        }
+        adjustRangeTotals(book, order->parentLimit, -shares);
+        noteLimitChange(book, order->buyOrSell, order->limit, order->parentLimit);
+        return 1;
+    }
+    return cancelOrder(book, order);
+}
+
+Order*
+executeOrderById(Book *book, uint64_t id, Quantity shares){
+    /**
+     * Execute the given number of shares of the order with the given id,
+     * like executeOrderShares(). Returns the order, or NULL if there is no
+     * such order in the book.
+     */
+    Order *ptr_order = getOrderById(book, id);
+    if(ptr_order == NULL){
+        return NULL;
+    }
+    executeOrderShares(book, ptr_order, shares);
+    return ptr_order;
+}
+
+static int
+reserveOrderMeta(Book *book, size_t capacity){
+    /**
+     * Grow the order metadata table to at least the given number of slots.
+     */
+    if(capacity <= book->orderMetaCapacity){
+        return 1;
+    }
+    OrderMeta *meta = realloc(book->orderMeta, capacity * sizeof(OrderMeta));
+    if(meta == NULL){
+        return 0;
+    }
+    book->orderMeta = meta;
+    book->orderMetaCapacity = capacity;
+    return 1;
+}
+
+int
+reservePools(Book *book, size_t expectedLimits, size_t expectedOrders, int flags){
+    /**
+     * Preallocate the book's pools for the given number of tree limits and
+     * orders from allocateOrder(), optionally backed by huge pages (flags
+     * POOL_HUGE_PAGES). The pools still grow if they run dry, but only then
+     * call malloc.
+     *
+     * Returns 0 if the book is not empty, or holds orders or limits from its
+     * pools anywhere else, such as in an epoch domain or with the caller.
+     * The new pools are built before the old ones are dropped, so the book
+     * is unchanged if they cannot be allocated.
+     */
+    Pool limitPool;
+    Pool orderPool;
+    if(book->highestBuy != NULL || book->lowestSell != NULL
+       || book->limitPool.count != 2 || book->orderPool.count != 0){
+        return 0;
+    }
+    if(!initPool(&limitPool, sizeof(Limit), expectedLimits + 2, flags)){
+        return 0;
+    }
+    if(!initPool(&orderPool, sizeof(Order), expectedOrders, flags | POOL_CACHE_ALIGNED | POOL_HANDLES)){
+        destroyPool(&limitPool);
+        return 0;
+    }
+    if(!reserveOrderMeta(book, getPoolCapacity(&orderPool))){
+        destroyPool(&orderPool);
+        destroyPool(&limitPool);
+        return 0;
+    }
+    destroyPool(&book->limitPool);
+    destroyPool(&book->orderPool);
+    book->limitPool = limitPool;
+    book->orderPool = orderPool;
+    book->buyTree = createPooledRoot(&book->limitPool);
+    book->sellTree = createPooledRoot(&book->limitPool);
+    return 1;
+}
+
+Order*
+allocateOrder(Book *book){
+    /**
+     * Return a fresh order from the book's order pool, with cleared
+     * metadata, or NULL if the pool cannot grow. Orders still in the book
+     * when it is destroyed are freed with it.
+     */
+    Order *order = allocFromPool(&book->orderPool);
+    if(order == NULL){
+        return NULL;
+    }
+    if(!reserveOrderMeta(book, getPoolCapacity(&book->orderPool))){
+        freeToPool(&book->orderPool, order);
+        return NULL;
+    }
+    initOrder(order);
+    initOrderMeta(getOrderMeta(book, order));
+    return order;
+}
+
+void
+releaseOrder(Book *book, Order *order){
+    /**
+     * Return an order from allocateOrder() to the pool; it must not be in
+     * the book anymore. With an epoch domain, the order is only reused once
+     * no reader can see it.
+     */
+    releaseToPool(book, &book->orderPool, order);
+}
+
+OrderMeta*
+getOrderMeta(Book *book, Order *order){
+    /**
+     * Return the metadata of an order from allocateOrder(), or NULL for
+     * orders allocated elsewhere.
+     *
+     * Metadata lives in a table indexed by the order's pool slot, so that
+     * walking the book never pulls it into the cache.
+     */
+    size_t slot = getPoolSlot(&book->orderPool, order);
+    if(slot >= book->orderMetaCapacity){
+        return NULL;
+    }
+    return &book->orderMeta[slot];
+}
+
+uint64_t
+getOrderHandle(Book *book, Order *order){
+    /**
+     * Return a 64 bit handle to an order from allocateOrder(), or
+     * INVALID_HANDLE for orders allocated elsewhere.
+     *
+     * Clients can keep handles instead of pointers: once the order is
+     * released, its handle no longer resolves, even after the order's
+     * memory has been reused for another order.
+     */
+    if(getPoolSlot(&book->orderPool, order) == (size_t)-1){
+        return INVALID_HANDLE;
+    }
+    return getPoolHandle(&book->orderPool, order);
+}
+
+Order*
+getOrderByHandle(Book *book, uint64_t handle){
+    /**
+     * Return the order of the given handle, or NULL if it has been released.
+     */
+    return getPoolObjectByHandle(&book->orderPool, handle);
+}
+
+int
+initLadders(Book *book, Price tickSize, size_t capacity){
+    /**
+     * Switch the book to ladder mode: limits within a window of the given
+     * number of ticks around each side's inside are kept in a dense ladder,
+     * and only the limits beyond it in the limit trees.
+     *
+     * Must be called while the book is empty, and not on a book with an
+     * epoch domain attached; see attachEpochDomain().
+     */
+    if(book->highestBuy != NULL || book->lowestSell != NULL || book->buyLadder != NULL
+       || book->epochs != NULL){
+        return 0;
+    }
+    Ladder *buyLadder = malloc(sizeof(Ladder));
+    Ladder *sellLadder = malloc(sizeof(Ladder));
+    if(buyLadder == NULL || sellLadder == NULL || !initLadder(buyLadder, tickSize, capacity)){
+        free(buyLadder);
+        free(sellLadder);
+        return 0;
+    }
+    if(!initLadder(sellLadder, tickSize, capacity)){
+        destroyLadder(buyLadder);
+        free(buyLadder);
+        free(sellLadder);
+        return 0;
+    }
+    book->buyLadder = buyLadder;
+    book->sellLadder = sellLadder;
+    return 1;
+}
+
+Limit*
+findBookLimit(Book *book, unsigned buyOrSell, Price price){
+    /**
+     * Return the limit of the given side at the given price, or NULL if
+     * there are no orders at that price.
+     */
+    Limit *tree = buyOrSell == BUY ? book->buyTree : book->sellTree;
+    Ladder *ladder = buyOrSell == BUY ? book->buyLadder : book->sellLadder;
+    Limit *limit;
+    if(ladder != NULL){
+        limit = getLadderLimit(ladder, price);
+        if(limit != NULL){
+            return limit->headOrder != NULL ? limit : NULL;
+        }
+    }
+    return findLimit(tree, price);
+}
+
+int
+recenterBookSide(Book *book, unsigned buyOrSell, Price price){
+    /**
+     * Move the window of the side's ladder so that it is placed around the
+     * given inside price, and point the cached inside at its new location.
+     * Returns 0 and changes nothing if the limit pool cannot grow.
+     */
+    Limit *tree = buyOrSell == BUY ? book->buyTree : book->sellTree;
+    Ladder *ladder = buyOrSell == BUY ? book->buyLadder : book->sellLadder;
+    Limit **inside = buyOrSell == BUY ? &book->highestBuy : &book->lowestSell;
+    int hasInside = *inside != NULL;
+    Price insidePrice = hasInside ? (*inside)->limitPrice : price;
+
+    if(!moveLadderWindow(ladder, tree, &book->limitPool, buyOrSell, getLadderBaseTick(ladder, buyOrSell, price))){
+        return 0;
+    }
+    if(hasInside){
+        *inside = findBookLimit(book, buyOrSell, insidePrice);
+    }
+    return 1;
+}
+
+Limit*
+getNextBookLimit(Book *book, Limit *limit, unsigned buyOrSell){
+    /**
+     * Return the next limit of the given side after the given one, away
+     * from the inside, or NULL if there is none.
+     */
+    Limit *tree = buyOrSell == BUY ? book->buyTree : book->sellTree;
+    Ladder *ladder = buyOrSell == BUY ? book->buyLadder : book->sellLadder;
+    if(ladder != NULL && ladderContains(ladder, limit)){
+        Limit *next = getNextLadderLimit(ladder, limit, buyOrSell);
+        if(next == NULL){
+            next = buyOrSell == BUY ? getPredecessor(tree) : getSuccessor(tree);
+        }
+        return next;
+    }
+    return buyOrSell == BUY ? getPredecessor(limit) : getSuccessor(limit);
+}
+
+Limit*
+getBestBid(Book *book){
+    return book->highestBuy;
+}
+
+Limit*
+getBestOffer(Book *book){
+    return book->lowestSell;
+}
+
+void
+getTopOfBook(Book *book, TopOfBook *top){
+    /**
+     * Summarise the inside of both sides. An empty side has no size and
+     * a price of MIN_PRICE (bids) or MAX_PRICE (asks).
+     */
+    Limit *bid = book->highestBuy;
+    Limit *ask = book->lowestSell;
+    top->bidPrice = bid != NULL ? bid->limitPrice : MIN_PRICE;
+    top->bidSize = bid != NULL ? bid->size : 0;
+    top->bidOrders = bid != NULL ? bid->orderCount : 0;
+    top->askPrice = ask != NULL ? ask->limitPrice : MAX_PRICE;
+    top->askSize = ask != NULL ? ask->size : 0;
+    top->askOrders = ask != NULL ? ask->orderCount : 0;
+}
+
+void
+enableRangeTotals(Book *book){
+    /**
+     * Keep the subtree totals of the book's trees up to date from now on,
+     * so that getBookSizeBetween() takes O(log M) in the tree.
+     *
+     * This costs every add, cancel and execution a walk from its limit to
+     * the root, O(log M) instead of O(1), so only books which answer range
+     * queries often should enable it. The totals are rebuilt here in O(M).
+     */
+    book->rangeTotals = 1;
+    rebuildSubtreeTotals(book->buyTree);
+    rebuildSubtreeTotals(book->sellTree);
+}
+
+Quantity
+getBookSizeBetween(Book *book, unsigned buyOrSell, Price low, Price high, Volume *volume){
+    /**
+     * Return the total size resting on one side of the book at prices from
+     * low to high, inclusive, and write its total volume to volume if it is
+     * not NULL. The tree part takes O(log M) after enableRangeTotals(), and
+     * visits the limits in range otherwise; the ladder part visits only the
+     * occupied levels in range.
+     */
+    Limit *tree = buyOrSell == BUY ? book->buyTree : book->sellTree;
+    Ladder *ladder = buyOrSell == BUY ? book->buyLadder : book->sellLadder;
+    Volume treeVolume;
+    Quantity size = book->rangeTotals ? getSizeBetween(tree, low, high, &treeVolume)
+                                      : walkSizeBetween(tree, low, high, &treeVolume);
+    if(ladder != NULL && low <= high){
+        Volume ladderVolume;
+        size += getLadderSizeBetween(ladder, low, high, &ladderVolume);
+        treeVolume += ladderVolume;
+    }
+    if(volume != NULL){
+        *volume = treeVolume;
+    }
+    return size;
+}
+
+void
+destroyLimitTree(Limit *limit){
+    /**
+     * Free the given limit and all limits below it, for trees built from
+     * createRoot() and malloc'ed limits. Orders are owned by the caller
+     * and are left untouched.
+     */
+    if(limit == NULL){
+        return;
+    }
+    destroyLimitTree(limit->leftChild);
+    destroyLimitTree(limit->rightChild);
+    destroyQueueIndex(limit);
+    free(limit);
+}
+
+static void
+destroyQueueIndexes(Limit *limit){
+    /**
+     * Free the queue indexes of the given limit and all limits below it.
+     */
+    if(limit == NULL){
+        return;
+    }
+    destroyQueueIndexes(limit->leftChild);
+    destroyQueueIndexes(limit->rightChild);
+    destroyQueueIndex(limit);
+}
+
+void
+destroyBook(Book *book){
+    /**
+     * Free all limits of the book, including both roots and the ladders,
+     * and all orders from allocateOrder() with their metadata.
+     */
+    destroyBookDepth(book);
+    if(book->epochs != NULL){
+        releaseRetiredObjects(book->epochs);
+    }
+    destroyQueueIndexes(book->buyTree);
+    destroyQueueIndexes(book->sellTree);
+    destroyPool(&book->limitPool);
+    destroyPool(&book->orderPool);
+    free(book->orderMeta);
+    book->orderMeta = NULL;
+    book->orderMetaCapacity = 0;
+    book->buyTree = NULL;
+    book->sellTree = NULL;
+    book->highestBuy = NULL;
+    book->lowestSell = NULL;
+    if(book->orders.slots != NULL){
+        destroyOrderMap(&book->orders);
+    }
+    if(book->buyLadder != NULL){
+        destroyLadder(book->buyLadder);
+        destroyLadder(book->sellLadder);
+        free(book->buyLadder);
+        free(book->sellLadder);
+        book->buyLadder = NULL;
+        book->sellLadder = NULL;
+    }
+}
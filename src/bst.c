@@ -13,10 +13,8 @@ balanceBranch(Limit *limit) {
     /**
      * Balance the nodes of the given branch of Limit structs.
      *
-     * Asserts that limit has a height of at least 2.
+     * Does nothing if the branch's balance factor is within [-1, 1].
      */
-    assert(getHeight(limit) < 2);
-
     int balanceFactor = getBalanceFactor(limit);
     if(balanceFactor > 1){
         /*Right is heavier.*/
@@ -24,23 +22,61 @@ balanceBranch(Limit *limit) {
         if(balanceFactor < 0){
             rotateRightLeft(limit);
         }
-        else if(balanceFactor > 0){
+        else{
             rotateRightRight(limit);
         }
     }
     else if(balanceFactor < -1){
         /*Left is heavier.*/
         balanceFactor = getBalanceFactor(limit->leftChild);
-        if(balanceFactor < 0){
-            rotateLeftLeft(limit);
-        }
-        else if(balanceFactor > 0){
+        if(balanceFactor > 0){
             rotateLeftRight(limit);
         }
+        else{
+            rotateLeftLeft(limit);
+        }
     }
     else{/*Everything is fine, do nothing*/}
 }
 
+void
+retraceBalance(Limit *limit){
+    /**
+     * Walk up from the given limit to the root, updating the cached heights
+     * and balancing every branch that has become unbalanced.
+     *
+     * Stops as soon as a branch's height is unchanged, since nothing above
+     * it can have changed either. Used after an insertion or removal, so
+     * both are O(log M).
+     */
+    int oldHeight;
+    int balanceFactor;
+    int heightsRetraced = 0;
+    while(limit != NULL && !limitIsRoot(limit)){
+        oldHeight = limit->height;
+        updateHeight(limit);
+        balanceFactor = getBalanceFactor(limit);
+        if(balanceFactor > 1 || balanceFactor < -1){
+            balanceBranch(limit);
+            /*The limit was rotated down; continue at the new top of the branch.*/
+            limit = limit->parent;
+            if(limit->height == oldHeight){
+                return;
+            }
+            /*The rotation retraced the heights above, so they can no longer
+            tell us where to stop; check the balance all the way up.*/
+            heightsRetraced = 1;
+        }
+        else if(!heightsRetraced && limit->height == oldHeight){
+            return;
+        }
+        limit = limit->parent;
+    }
+    if(limit != NULL){
+        updateHeight(limit);
+    }
+}
+
 void
 rotateLeftLeft(Limit *limit) {
     /**
@@ -60,6 +96,14 @@ rotateLeftLeft(Limit *limit) {
     Limit* tmp_ptr = child->rightChild;
     child->rightChild = limit;
     limit->leftChild = tmp_ptr;
+    if(tmp_ptr != NULL){
+        tmp_ptr->parent = limit;
+    }
+    updateHeight(limit);
+    updateHeight(child);
+    updateSubtreeTotals(limit);
+    updateSubtreeTotals(child);
+    retraceHeight(child->parent);
     return;
 }
 
@@ -85,6 +129,13 @@ rotateLeftRight(Limit *limit) {
     grandChild->rightChild = tmp_d_ptr;
     child->leftChild = tmp_b_ptr;
     child->rightChild = tmp_c_ptr;
+    if(tmp_c_ptr != NULL){
+        tmp_c_ptr->parent = child;
+    }
+    updateHeight(child);
+    updateHeight(grandChild);
+    updateSubtreeTotals(child);
+    updateSubtreeTotals(grandChild);
     rotateLeftLeft(limit);
     return;
 }
@@ -108,6 +159,14 @@ rotateRightRight(Limit *limit){
     Limit* tmp_ptr = child->leftChild;
     child->leftChild = limit;
     limit->rightChild = tmp_ptr;
+    if(tmp_ptr != NULL){
+        tmp_ptr->parent = limit;
+    }
+    updateHeight(limit);
+    updateHeight(child);
+    updateSubtreeTotals(limit);
+    updateSubtreeTotals(child);
+    retraceHeight(child->parent);
     return;
 }
 
@@ -131,6 +190,13 @@ rotateRightLeft(Limit *limit){
     grandChild->leftChild = tmp_d_ptr;
     child->leftChild = tmp_c_ptr;
     child->rightChild = tmp_b_ptr;
+    if(tmp_c_ptr != NULL){
+        tmp_c_ptr->parent = child;
+    }
+    updateHeight(child);
+    updateHeight(grandChild);
+    updateSubtreeTotals(child);
+    updateSubtreeTotals(grandChild);
 
     rotateRightRight(limit);
     return;
@@ -2,11 +2,24 @@
  * Contains complimentary data structures needed to run the LOB.
  */
 #include <stdlib.h>
+#include <string.h>
 #include "hftlob.h"
 
-void
+int
 pushToQueue(Queue *q, Limit *limit){
-    QueueItem *ptr_newItem = malloc(sizeof(QueueItem));
+    /**
+     * Append the limit to the queue. Returns 0 if no item can be allocated.
+     */
+    QueueItem *ptr_newItem;
+    if(q->itemPool != NULL){
+        ptr_newItem = allocFromPool(q->itemPool);
+    }
+    else{
+        ptr_newItem = malloc(sizeof(QueueItem));
+    }
+    if(ptr_newItem == NULL){
+        return 0;
+    }
     ptr_newItem->limit = limit;
 
     if(q->head != NULL){
@@ -16,6 +29,7 @@ pushToQueue(Queue *q, Limit *limit){
     ptr_newItem->previous = q->tail;
     q->tail = ptr_newItem;
     q->size++;
+    return 1;
 }
 
 Limit*
@@ -30,7 +44,12 @@ popFromQueue(Queue *q){
         q->head = NULL;
     }
     q->size--;
-    free(poppedItem);
+    if(q->itemPool != NULL){
+        freeToPool(q->itemPool, poppedItem);
+    }
+    else{
+        free(poppedItem);
+    }
     return poppedLimit;
 }
 
@@ -41,3 +60,451 @@ queueIsEmpty(Queue *q){
     }
     return 0;
 }
+
+
+/**
+ * Bitmap: a hierarchical occupancy bitmap.
+ *
+ * Finding the nearest set bit below or above an index takes one count
+ * leading/trailing zeros instruction per level, so at most four for 2^24
+ * indices, and touches one word per level.
+ */
+
+int
+initBitmap(Bitmap *bitmap, size_t size){
+    /**
+     * Allocate an empty bitmap for at least the given number of bits,
+     * with all levels in a single allocation.
+     */
+    size_t words[BITMAP_MAX_LEVELS];
+    size_t total = 0;
+    size_t bits = size;
+    int level = 0;
+    do{
+        words[level] = (bits + 63) / 64;
+        total += words[level];
+        bits = words[level];
+        level++;
+    } while(bits > 1 && level < BITMAP_MAX_LEVELS);
+    if(bits > 1){
+        return 0;
+    }
+
+    uint64_t *memory = calloc(total, sizeof(uint64_t));
+    if(memory == NULL){
+        return 0;
+    }
+    bitmap->levels = level;
+    bitmap->size = size;
+    for(level=0; level<bitmap->levels; level++){
+        bitmap->words[level] = memory;
+        memory += words[level];
+    }
+    return 1;
+}
+
+void
+destroyBitmap(Bitmap *bitmap){
+    free(bitmap->words[0]);
+    bitmap->words[0] = NULL;
+    bitmap->levels = 0;
+    bitmap->size = 0;
+}
+
+void
+setBitmapBit(Bitmap *bitmap, size_t index){
+    int level;
+    for(level=0; level<bitmap->levels; level++){
+        uint64_t *word = &bitmap->words[level][index >> 6];
+        int wasEmpty = *word == 0;
+        *word |= 1ULL << (index & 63);
+        if(!wasEmpty){
+            return;
+        }
+        index >>= 6;
+    }
+}
+
+void
+clearBitmapBit(Bitmap *bitmap, size_t index){
+    int level;
+    for(level=0; level<bitmap->levels; level++){
+        uint64_t *word = &bitmap->words[level][index >> 6];
+        *word &= ~(1ULL << (index & 63));
+        if(*word != 0){
+            return;
+        }
+        index >>= 6;
+    }
+}
+
+static int64_t
+findBitAtOrBelow(Bitmap *bitmap, int level, int64_t index){
+    if(index < 0){
+        return -1;
+    }
+    int64_t word = index >> 6;
+    int bit = index & 63;
+    uint64_t bits = bitmap->words[level][word];
+    if(bit != 63){
+        bits &= (2ULL << bit) - 1;
+    }
+    if(bits == 0){
+        /* Ask the level above for the nearest non-empty word below. */
+        if(level + 1 >= bitmap->levels){
+            return -1;
+        }
+        word = findBitAtOrBelow(bitmap, level + 1, word - 1);
+        if(word < 0){
+            return -1;
+        }
+        bits = bitmap->words[level][word];
+    }
+    return (word << 6) + 63 - __builtin_clzll(bits);
+}
+
+static int64_t
+findBitAtOrAbove(Bitmap *bitmap, int level, int64_t index, int64_t words){
+    int64_t word = index >> 6;
+    if(word >= words){
+        return -1;
+    }
+    uint64_t bits = bitmap->words[level][word] & (~0ULL << (index & 63));
+    if(bits == 0){
+        if(level + 1 >= bitmap->levels){
+            return -1;
+        }
+        word = findBitAtOrAbove(bitmap, level + 1, word + 1, (words + 63) / 64);
+        if(word < 0){
+            return -1;
+        }
+        bits = bitmap->words[level][word];
+    }
+    return (word << 6) + __builtin_ctzll(bits);
+}
+
+int64_t
+findBitmapBitAtOrBelow(Bitmap *bitmap, int64_t index){
+    /**
+     * Return the highest set bit at or below the given index, or -1.
+     */
+    if(index >= (int64_t)bitmap->size){
+        index = bitmap->size - 1;
+    }
+    return findBitAtOrBelow(bitmap, 0, index);
+}
+
+int64_t
+findBitmapBitAtOrAbove(Bitmap *bitmap, int64_t index){
+    /**
+     * Return the lowest set bit at or above the given index, or -1.
+     */
+    if(index < 0){
+        index = 0;
+    }
+    int64_t found = findBitAtOrAbove(bitmap, 0, index, (bitmap->size + 63) / 64);
+    if(found >= (int64_t)bitmap->size){
+        return -1;
+    }
+    return found;
+}
+
+/**
+ * Order map: open addressing with Robin Hood probing, keyed by Order.id.
+ *
+ * The map is sized up front by initOrderMap() and never rehashes; inserts
+ * fail once it is three quarters full. Slots are 16 bytes, so a lookup
+ * usually touches a single cache line.
+ */
+
+static size_t
+getOrderMapHome(OrderMap *map, uint64_t id){
+    /* Fibonacci hashing; the top bits of the product are well mixed. */
+    return (size_t)((id * 0x9E3779B97F4A7C15ULL) >> map->shift);
+}
+
+int
+initOrderMap(OrderMap *map, size_t expectedOrders){
+    size_t capacity = 8;
+    int bits = 3;
+    while(capacity / 4 * 3 < expectedOrders){
+        capacity *= 2;
+        bits++;
+    }
+    map->slots = calloc(capacity, sizeof(OrderMapSlot));
+    if(map->slots == NULL){
+        return 0;
+    }
+    map->capacity = capacity;
+    map->count = 0;
+    map->maxCount = capacity / 4 * 3;
+    map->shift = 64 - bits;
+    return 1;
+}
+
+void
+destroyOrderMap(OrderMap *map){
+    free(map->slots);
+    map->slots = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    map->maxCount = 0;
+}
+
+int
+insertIntoOrderMap(OrderMap *map, Order *order){
+    /**
+     * Insert the order under its id. Returns 0 if the id is already
+     * present or the map is full.
+     */
+    if(map->count >= map->maxCount){
+        return 0;
+    }
+    size_t mask = map->capacity - 1;
+    size_t index = getOrderMapHome(map, order->id);
+    size_t distance = 0;
+    size_t slotDistance;
+    int displaced = 0;
+    OrderMapSlot entry = {order->id, order};
+    OrderMapSlot tmp;
+
+    while(1){
+        OrderMapSlot *slot = &map->slots[index];
+        if(slot->order == NULL){
+            *slot = entry;
+            map->count++;
+            return 1;
+        }
+        if(!displaced && slot->id == entry.id){
+            return 0;
+        }
+        slotDistance = (index - getOrderMapHome(map, slot->id)) & mask;
+        if(slotDistance < distance){
+            /* Take the slot from the richer entry and carry that one on. */
+            tmp = *slot;
+            *slot = entry;
+            entry = tmp;
+            distance = slotDistance;
+            displaced = 1;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+}
+
+static size_t
+findInOrderMap(OrderMap *map, uint64_t id){
+    /**
+     * Return the index of the slot holding id, or map->capacity if the
+     * id is not in the map.
+     */
+    size_t mask = map->capacity - 1;
+    size_t index = getOrderMapHome(map, id);
+    size_t distance = 0;
+    while(1){
+        OrderMapSlot *slot = &map->slots[index];
+        if(slot->order == NULL){
+            return map->capacity;
+        }
+        if(slot->id == id){
+            return index;
+        }
+        if(((index - getOrderMapHome(map, slot->id)) & mask) < distance){
+            /* id would have displaced this entry, so it is not present. */
+            return map->capacity;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+}
+
+size_t
+getOrderMapHomeSlot(OrderMap *map, uint64_t id){
+    /**
+     * Return the index of the slot a lookup of id starts at, for callers
+     * which prefetch it and read it with getOrderInMapSlot() later.
+     */
+    return getOrderMapHome(map, id);
+}
+
+Order*
+getOrderInMapSlot(OrderMap *map, size_t index, uint64_t id){
+    /**
+     * Return the order in the given slot if the slot holds id, or NULL.
+     * NULL does not mean id is absent, as it may sit further on; fall back
+     * to getFromOrderMap() then.
+     */
+    OrderMapSlot *slot = &map->slots[index];
+    if(slot->order != NULL && slot->id == id){
+        return slot->order;
+    }
+    return NULL;
+}
+
+Order*
+getFromOrderMap(OrderMap *map, uint64_t id){
+    size_t index = findInOrderMap(map, id);
+    if(index == map->capacity){
+        return NULL;
+    }
+    return map->slots[index].order;
+}
+
+Order*
+removeFromOrderMap(OrderMap *map, uint64_t id){
+    /**
+     * Remove and return the order with the given id, or NULL if there is none.
+     *
+     * Uses backward shift deletion, so no tombstones are left behind.
+     */
+    size_t index = findInOrderMap(map, id);
+    if(index == map->capacity){
+        return NULL;
+    }
+    size_t mask = map->capacity - 1;
+    Order *removed = map->slots[index].order;
+    size_t next = (index + 1) & mask;
+    while(map->slots[next].order != NULL && getOrderMapHome(map, map->slots[next].id) != next){
+        map->slots[index] = map->slots[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+    map->slots[index].order = NULL;
+    map->count--;
+    return removed;
+}
+
+
+/**
+ * Tid map: interns Order.tid strings into 64 bit ids for the order map.
+ *
+ * Same probing scheme as the order map. Ids start at 1; 0 means the tid
+ * is unknown or the map is full. The strings are not copied and must
+ * outlive their entry, as Order.tid already does.
+ */
+
+static uint64_t
+hashTid(const char *tid){
+    /* 64 bit FNV-1a, with the high bits folded in for the mask. */
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    while(*tid != '\0'){
+        hash ^= (unsigned char)*tid++;
+        hash *= 0x100000001B3ULL;
+    }
+    return hash ^ (hash >> 32);
+}
+
+int
+initTidMap(TidMap *map, size_t expectedTids){
+    size_t capacity = 8;
+    while(capacity / 4 * 3 < expectedTids){
+        capacity *= 2;
+    }
+    map->slots = calloc(capacity, sizeof(TidMapSlot));
+    if(map->slots == NULL){
+        return 0;
+    }
+    map->capacity = capacity;
+    map->count = 0;
+    map->maxCount = capacity / 4 * 3;
+    map->nextId = 1;
+    return 1;
+}
+
+void
+destroyTidMap(TidMap *map){
+    free(map->slots);
+    map->slots = NULL;
+    map->capacity = 0;
+    map->count = 0;
+    map->maxCount = 0;
+}
+
+static size_t
+findInTidMap(TidMap *map, const char *tid, uint64_t hash){
+    size_t mask = map->capacity - 1;
+    size_t index = hash & mask;
+    size_t distance = 0;
+    while(1){
+        TidMapSlot *slot = &map->slots[index];
+        if(slot->tid == NULL){
+            return map->capacity;
+        }
+        if(slot->hash == hash && strcmp(slot->tid, tid) == 0){
+            return index;
+        }
+        if(((index - slot->hash) & mask) < distance){
+            return map->capacity;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+}
+
+uint64_t
+lookupTid(TidMap *map, const char *tid){
+    size_t index = findInTidMap(map, tid, hashTid(tid));
+    if(index == map->capacity){
+        return 0;
+    }
+    return map->slots[index].id;
+}
+
+uint64_t
+internTid(TidMap *map, const char *tid){
+    /**
+     * Return the id of the given tid, assigning the next free id if
+     * the tid has not been seen before.
+     */
+    uint64_t hash = hashTid(tid);
+    size_t index = findInTidMap(map, tid, hash);
+    if(index != map->capacity){
+        return map->slots[index].id;
+    }
+    if(map->count >= map->maxCount){
+        return 0;
+    }
+
+    size_t mask = map->capacity - 1;
+    size_t distance = 0;
+    size_t slotDistance;
+    TidMapSlot entry = {hash, tid, map->nextId};
+    TidMapSlot tmp;
+    index = hash & mask;
+    while(map->slots[index].tid != NULL){
+        slotDistance = (index - map->slots[index].hash) & mask;
+        if(slotDistance < distance){
+            tmp = map->slots[index];
+            map->slots[index] = entry;
+            entry = tmp;
+            distance = slotDistance;
+        }
+        index = (index + 1) & mask;
+        distance++;
+    }
+    map->slots[index] = entry;
+    map->count++;
+    return map->nextId++;
+}
+
+uint64_t
+releaseTid(TidMap *map, const char *tid){
+    /**
+     * Forget the given tid and return the id it had, or 0 if it was unknown.
+     */
+    size_t index = findInTidMap(map, tid, hashTid(tid));
+    if(index == map->capacity){
+        return 0;
+    }
+    size_t mask = map->capacity - 1;
+    uint64_t id = map->slots[index].id;
+    size_t next = (index + 1) & mask;
+    while(map->slots[next].tid != NULL && (map->slots[next].hash & mask) != next){
+        map->slots[index] = map->slots[next];
+        index = next;
+        next = (next + 1) & mask;
+    }
+    map->slots[index].tid = NULL;
+    map->count--;
+    return id;
+}
@@ -0,0 +1,156 @@
+/**
+ * Depth Operations
+ *
+ * A book can keep the price, size and order count of the best N levels of
+ * each side in a contiguous array, most aggressive level first. The book
+ * operations update it as limits change; a change beyond the N-th level is
+ * rejected with one compare, and one inside it costs a binary search and a
+ * memmove of at most N levels. Reading the depth is then a single memcpy.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "hftlob.h"
+
+
+static int
+priceIsBetter(unsigned buyOrSell, Price price, Price other){
+    if(buyOrSell == BUY){
+        return price > other;
+    }
+    return price < other;
+}
+
+static Depth*
+getSideDepth(Book *book, unsigned buyOrSell){
+    return buyOrSell == BUY ? &book->buyDepth : &book->sellDepth;
+}
+
+static void
+refillDepth(Book *book, unsigned buyOrSell, Depth *depth){
+    /**
+     * Append the level after the last one kept, if there is one.
+     */
+    Limit *next;
+    if(depth->count == 0){
+        next = buyOrSell == BUY ? book->highestBuy : book->lowestSell;
+    }
+    else{
+        next = findBookLimit(book, buyOrSell, depth->levels[depth->count - 1].price);
+        next = next != NULL ? getNextBookLimit(book, next, buyOrSell) : NULL;
+    }
+    if(next != NULL){
+        depth->levels[depth->count].price = next->limitPrice;
+        depth->levels[depth->count].size = next->size;
+        depth->levels[depth->count].orders = next->orderCount;
+        depth->count++;
+    }
+}
+
+int
+initBookDepth(Book *book, int levels){
+    /**
+     * Keep the best given number of levels of both sides of the book in
+     * Book.buyDepth and Book.sellDepth from now on, starting with the
+     * current ones. A count of 0 stops keeping them.
+     */
+    unsigned side;
+    destroyBookDepth(book);
+    if(levels <= 0){
+        return 1;
+    }
+    for(side=0; side<2; side++){
+        Depth *depth = getSideDepth(book, side);
+        depth->levels = malloc(levels * sizeof(DepthLevel));
+        if(depth->levels == NULL){
+            destroyBookDepth(book);
+            return 0;
+        }
+        depth->capacity = levels;
+        depth->count = 0;
+        while(depth->count < depth->capacity){
+            int count = depth->count;
+            refillDepth(book, side, depth);
+            if(depth->count == count){
+                break;
+            }
+        }
+    }
+    return 1;
+}
+
+void
+destroyBookDepth(Book *book){
+    free(book->buyDepth.levels);
+    free(book->sellDepth.levels);
+    book->buyDepth.levels = NULL;
+    book->sellDepth.levels = NULL;
+    book->buyDepth.capacity = book->sellDepth.capacity = 0;
+    book->buyDepth.count = book->sellDepth.count = 0;
+}
+
+void
+updateBookDepth(Book *book, unsigned buyOrSell, Price price, Limit *limit){
+    /**
+     * Bring the depth of the given side up to date after the limit at the
+     * given price changed. limit is NULL if the limit has been removed.
+     */
+    Depth *depth = getSideDepth(book, buyOrSell);
+    DepthLevel *levels = depth->levels;
+    if(levels == NULL){
+        return;
+    }
+    if(depth->count == depth->capacity
+       && priceIsBetter(buyOrSell, levels[depth->count - 1].price, price)){
+        return;
+    }
+
+    int low = 0;
+    int high = depth->count;
+    while(low < high){
+        int mid = (low + high) / 2;
+        if(priceIsBetter(buyOrSell, levels[mid].price, price)){
+            low = mid + 1;
+        }
+        else{
+            high = mid;
+        }
+    }
+
+    if(low < depth->count && levels[low].price == price){
+        if(limit != NULL){
+            levels[low].size = limit->size;
+            levels[low].orders = limit->orderCount;
+            return;
+        }
+        memmove(&levels[low], &levels[low + 1], (depth->count - low - 1) * sizeof(DepthLevel));
+        depth->count--;
+        if(depth->count == depth->capacity - 1){
+            /* The level behind the last one kept moves up into view. */
+            refillDepth(book, buyOrSell, depth);
+        }
+        return;
+    }
+    if(limit == NULL){
+        return;
+    }
+    if(depth->count < depth->capacity){
+        depth->count++;
+    }
+    memmove(&levels[low + 1], &levels[low], (depth->count - low - 1) * sizeof(DepthLevel));
+    levels[low].price = price;
+    levels[low].size = limit->size;
+    levels[low].orders = limit->orderCount;
+}
+
+int
+copyBookDepth(Book *book, unsigned buyOrSell, DepthLevel *levels, int maxLevels){
+    /**
+     * Copy up to maxLevels of the given side's kept depth to levels, and
+     * return how many were copied.
+     */
+    Depth *depth = getSideDepth(book, buyOrSell);
+    int count = depth->count < maxLevels ? depth->count : maxLevels;
+    memcpy(levels, depth->levels, count * sizeof(DepthLevel));
+    return count;
+}
@@ -0,0 +1,326 @@
+/**
+ * Engine Operations
+ *
+ * An engine spreads instruments over worker threads, instrument id modulo
+ * the number of workers. Each worker owns the books of its instruments
+ * outright, in a registry of its own, so books are only ever touched by
+ * one thread and need no locks.
+ *
+ * Events reach the workers through one single-producer/single-consumer
+ * ring per worker, filled by a single decode thread. A ring slot is handed
+ * over with one release store of the producer's index and taken back with
+ * one of the consumer's; each side keeps a cached copy of the other's
+ * index, so it only reads the shared cache line when the ring looks full
+ * or empty. Workers drain their ring in batches and apply each batch with
+ * dispatchEvents(). Events carry adds by value, so every order a worker's
+ * books hold comes from their own pools.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include "hftlob.h"
+
+#define ENGINE_DEFAULT_BATCH 64
+#define ENGINE_SPIN_ROUNDS 64
+#define ENGINE_YIELD_ROUNDS 128
+#define ENGINE_SLEEP_NS 50000
+
+
+int
+initSpscRing(SpscRing *ring, size_t capacity){
+    /**
+     * Allocate a ring for at least the given number of events.
+     */
+    size_t slots = 2;
+    while(slots < capacity){
+        slots *= 2;
+    }
+    ring->slots = malloc(slots * sizeof(Event));
+    if(ring->slots == NULL){
+        return 0;
+    }
+    ring->mask = slots - 1;
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->cachedHead = 0;
+    ring->cachedTail = 0;
+    return 1;
+}
+
+void
+destroySpscRing(SpscRing *ring){
+    free(ring->slots);
+    ring->slots = NULL;
+}
+
+int
+pushToSpscRing(SpscRing *ring, const Event *event){
+    /**
+     * Append an event to the ring. Returns 0 if the ring is full.
+     * Only one thread may push to a ring.
+     */
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    if(tail - ring->cachedHead > ring->mask){
+        ring->cachedHead = atomic_load_explicit(&ring->head, memory_order_acquire);
+        if(tail - ring->cachedHead > ring->mask){
+            return 0;
+        }
+    }
+    ring->slots[tail & ring->mask] = *event;
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return 1;
+}
+
+size_t
+popFromSpscRing(SpscRing *ring, Event *events, size_t maxEvents){
+    /**
+     * Move up to maxEvents of the oldest events of the ring to events, and
+     * return their number. Only one thread may pop from a ring.
+     */
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t count, i;
+    if(ring->cachedTail == head){
+        ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if(ring->cachedTail == head){
+            return 0;
+        }
+    }
+    count = ring->cachedTail - head;
+    if(count > maxEvents){
+        count = maxEvents;
+    }
+    for(i=0; i<count; i++){
+        events[i] = ring->slots[(head + i) & ring->mask];
+    }
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    return count;
+}
+
+static void
+relaxCpu(void){
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+static void
+waitForEvents(int waitPolicy, int idleRounds){
+    /**
+     * Wait a little before polling an empty ring again: spin, then with
+     * ENGINE_BACKOFF yield the core, then sleep.
+     */
+    if(waitPolicy == ENGINE_BUSY_POLL || idleRounds < ENGINE_SPIN_ROUNDS){
+        relaxCpu();
+    }
+    else if(idleRounds < ENGINE_YIELD_ROUNDS){
+        sched_yield();
+    }
+    else{
+        struct timespec pause = {0, ENGINE_SLEEP_NS};
+        nanosleep(&pause, NULL);
+    }
+}
+
+static void*
+runWorker(void *arg){
+    /**
+     * Apply the events of the worker's ring to its books until the engine
+     * is stopped and the ring is drained.
+     */
+    EngineWorker *worker = arg;
+    Engine *engine = worker->engine;
+    size_t batchSize = engine->config.batchSize;
+    Event *batch = worker->batch;
+    int idleRounds = 0;
+    while(1){
+        size_t count = popFromSpscRing(&worker->ring, batch, batchSize);
+        if(count > 0){
+            size_t failed = dispatchEvents(&worker->registry, batch, count);
+            atomic_fetch_add_explicit(&worker->processed, count, memory_order_relaxed);
+            atomic_fetch_add_explicit(&worker->failed, failed, memory_order_relaxed);
+            idleRounds = 0;
+            continue;
+        }
+        if(!atomic_load_explicit(&engine->running, memory_order_acquire)){
+            /* Everything pushed before the stop is visible now. */
+            if(atomic_load_explicit(&worker->ring.tail, memory_order_acquire)
+               == atomic_load_explicit(&worker->ring.head, memory_order_relaxed)){
+                break;
+            }
+            continue;
+        }
+        waitForEvents(engine->config.waitPolicy, idleRounds++);
+    }
+    return NULL;
+}
+
+void
+initEngineConfig(EngineConfig *config){
+    config->workerCount = 1;
+    config->ringCapacity = 1 << 16;
+    config->batchSize = ENGINE_DEFAULT_BATCH;
+    config->waitPolicy = ENGINE_BACKOFF;
+    config->firstCpu = -1;
+}
+
+int
+initEngine(Engine *engine, const EngineConfig *config, uint32_t instrumentCapacity){
+    /**
+     * Set up an engine with the given configuration for instrument ids
+     * below instrumentCapacity. Its workers start with startEngine().
+     */
+    int i;
+    engine->config = *config;
+    if(engine->config.workerCount < 1){
+        engine->config.workerCount = 1;
+    }
+    if(engine->config.batchSize < 1){
+        engine->config.batchSize = ENGINE_DEFAULT_BATCH;
+    }
+    engine->started = 0;
+    atomic_init(&engine->running, 0);
+    engine->workers = calloc(engine->config.workerCount, sizeof(EngineWorker));
+    if(engine->workers == NULL){
+        return 0;
+    }
+    for(i=0; i<engine->config.workerCount; i++){
+        EngineWorker *worker = &engine->workers[i];
+        worker->engine = engine;
+        worker->index = i;
+        atomic_init(&worker->processed, 0);
+        atomic_init(&worker->failed, 0);
+        worker->batch = malloc(engine->config.batchSize * sizeof(Event));
+        if(worker->batch == NULL
+           || !initSpscRing(&worker->ring, engine->config.ringCapacity)
+           || !initBookRegistry(&worker->registry, instrumentCapacity)){
+            engine->config.workerCount = i + 1;
+            destroyEngine(engine);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void
+destroyEngine(Engine *engine){
+    /**
+     * Stop the engine if it runs, and free its workers with all books.
+     */
+    int i;
+    if(engine->workers == NULL){
+        return;
+    }
+    stopEngine(engine);
+    for(i=0; i<engine->config.workerCount; i++){
+        free(engine->workers[i].batch);
+        destroySpscRing(&engine->workers[i].ring);
+        if(engine->workers[i].registry.entries != NULL){
+            destroyBookRegistry(&engine->workers[i].registry);
+        }
+    }
+    free(engine->workers);
+    engine->workers = NULL;
+}
+
+EngineWorker*
+getEngineWorker(Engine *engine, uint32_t instrument){
+    return &engine->workers[instrument % engine->config.workerCount];
+}
+
+int
+registerEngineInstrument(Engine *engine, uint32_t id, double tickSize, double lotSize, const BookTier *tier){
+    /**
+     * Register an instrument with the worker that owns it, like
+     * registerInstrument(). Must be called before startEngine().
+     */
+    if(engine->started){
+        return 0;
+    }
+    return registerInstrument(&getEngineWorker(engine, id)->registry, id, tickSize, lotSize, tier);
+}
+
+int
+startEngine(Engine *engine){
+    /**
+     * Start one thread per worker, pinned to consecutive cores from
+     * config.firstCpu unless that is negative.
+     */
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int i;
+    if(engine->started){
+        return 0;
+    }
+    atomic_store_explicit(&engine->running, 1, memory_order_release);
+    for(i=0; i<engine->config.workerCount; i++){
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if(engine->config.firstCpu >= 0 && cpus > 0){
+            cpu_set_t cpuSet;
+            CPU_ZERO(&cpuSet);
+            CPU_SET((engine->config.firstCpu + i) % cpus, &cpuSet);
+            pthread_attr_setaffinity_np(&attr, sizeof(cpuSet), &cpuSet);
+        }
+        int status = pthread_create(&engine->workers[i].thread, &attr, runWorker, &engine->workers[i]);
+        pthread_attr_destroy(&attr);
+        if(status != 0){
+            /* Stop the workers started so far. */
+            atomic_store_explicit(&engine->running, 0, memory_order_release);
+            while(i-- > 0){
+                pthread_join(engine->workers[i].thread, NULL);
+            }
+            return 0;
+        }
+    }
+    engine->started = 1;
+    return 1;
+}
+
+void
+stopEngine(Engine *engine){
+    /**
+     * Let the workers apply all events submitted so far, and wait for
+     * them to finish. Must be called from the thread submitting events.
+     */
+    int i;
+    if(!engine->started){
+        return;
+    }
+    atomic_store_explicit(&engine->running, 0, memory_order_release);
+    for(i=0; i<engine->config.workerCount; i++){
+        pthread_join(engine->workers[i].thread, NULL);
+    }
+    engine->started = 0;
+}
+
+int
+submitEngineEvent(Engine *engine, const Event *event){
+    /**
+     * Pass an event on to the worker owning its instrument. Returns 0 if
+     * that worker's ring is full; the caller may retry. Only one thread
+     * may submit events.
+     *
+     * Events must name orders by id and give adds by value; one with an
+     * Order pointer is refused with -1, as the submitting thread would
+     * share the order with the worker.
+     */
+    if(event->order != NULL){
+        return -1;
+    }
+    return pushToSpscRing(&getEngineWorker(engine, event->instrument)->ring, event);
+}
+
+Book*
+getEngineBook(Engine *engine, uint32_t id){
+    /**
+     * Return the book of the given instrument. Its worker owns it while
+     * the engine runs, so only read it once the engine is stopped.
+     */
+    return getInstrumentBook(&getEngineWorker(engine, id)->registry, id, 0);
+}
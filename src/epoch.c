@@ -0,0 +1,243 @@
+/**
+ * Epoch Operations
+ *
+ * Epoch-based reclamation lets reader threads walk a book's limits and
+ * orders while the thread changing the book keeps going. Readers announce
+ * the global epoch they entered in; objects the writer removes are retired
+ * into the bucket of the current epoch instead of being freed. The writer
+ * advances the epoch once every active reader has caught up with it, and
+ * an object retired two epochs ago can no longer be seen by anyone, so
+ * advancing frees that bucket. Neither side ever waits for the other.
+ *
+ * Readers walk the book through the getFirst/NextRead functions below,
+ * which follow the in-order links between limits and the order queues.
+ * The writer stores these links with release semantics, and a removed
+ * limit or order keeps its links until it is reclaimed, so a reader
+ * standing on one can always move on; at worst it misses changes made
+ * since. Values are stored and read with relaxed atomics and may be
+ * mid-update between levels, so a walk is a fuzzy view, not a snapshot.
+ * An order moved to another price is replaced by a fresh one, see
+ * modifyOrder(), as relinking it would carry its readers along.
+ *
+ * Books in ladder mode reuse ladder slots in place and are not supported.
+ */
+
+#include <stdlib.h>
+#include "hftlob.h"
+
+#define EPOCH_ADVANCE_INTERVAL 64
+
+
+void
+initEpochDomain(EpochDomain *domain){
+    int i;
+    atomic_init(&domain->epoch, 1);
+    for(i=0; i<EPOCH_MAX_READERS; i++){
+        atomic_init(&domain->readers[i].epoch, 0);
+        atomic_init(&domain->readers[i].used, 0);
+    }
+    for(i=0; i<3; i++){
+        domain->retired[i].objects = NULL;
+        domain->retired[i].count = 0;
+        domain->retired[i].capacity = 0;
+    }
+    domain->retiredSinceAdvance = 0;
+}
+
+void
+destroyEpochDomain(EpochDomain *domain){
+    /**
+     * Free the domain's lists. Objects still retired are not returned to
+     * their pools; call releaseRetiredObjects() first if the pools live on.
+     */
+    int i;
+    for(i=0; i<3; i++){
+        free(domain->retired[i].objects);
+        domain->retired[i].objects = NULL;
+        domain->retired[i].count = 0;
+        domain->retired[i].capacity = 0;
+    }
+}
+
+int
+registerEpochReader(EpochDomain *domain){
+    /**
+     * Claim a reader slot for the calling thread. Returns its index, or -1
+     * if all EPOCH_MAX_READERS slots are taken.
+     */
+    int i;
+    for(i=0; i<EPOCH_MAX_READERS; i++){
+        int unused = 0;
+        if(atomic_compare_exchange_strong(&domain->readers[i].used, &unused, 1)){
+            return i;
+        }
+    }
+    return -1;
+}
+
+void
+unregisterEpochReader(EpochDomain *domain, int reader){
+    atomic_store_explicit(&domain->readers[reader].epoch, 0, memory_order_release);
+    atomic_store_explicit(&domain->readers[reader].used, 0, memory_order_release);
+}
+
+void
+enterEpoch(EpochDomain *domain, int reader){
+    /**
+     * Start a read section: nothing retired from now on is reclaimed
+     * before the reader leaves it again.
+     */
+    EpochReader *slot = &domain->readers[reader];
+    uint64_t epoch = atomic_load(&domain->epoch);
+    while(1){
+        atomic_store(&slot->epoch, epoch);
+        /* The announcement must be visible before the epoch is checked. */
+        uint64_t current = atomic_load(&domain->epoch);
+        if(current == epoch){
+            return;
+        }
+        epoch = current;
+    }
+}
+
+void
+leaveEpoch(EpochDomain *domain, int reader){
+    atomic_store_explicit(&domain->readers[reader].epoch, 0, memory_order_release);
+}
+
+static void
+releaseRetiredList(RetiredList *list){
+    size_t i;
+    for(i=0; i<list->count; i++){
+        freeToPool(list->objects[i].pool, list->objects[i].object);
+    }
+    list->count = 0;
+}
+
+int
+tryAdvanceEpoch(EpochDomain *domain){
+    /**
+     * Advance the global epoch if every active reader has entered the
+     * current one, and reclaim the objects retired two epochs before.
+     * Returns 1 if the epoch advanced. Writer only.
+     */
+    uint64_t epoch = atomic_load(&domain->epoch);
+    int i;
+    atomic_thread_fence(memory_order_seq_cst);
+    for(i=0; i<EPOCH_MAX_READERS; i++){
+        uint64_t readerEpoch = atomic_load(&domain->readers[i].epoch);
+        if(readerEpoch != 0 && readerEpoch != epoch){
+            return 0;
+        }
+    }
+    atomic_store(&domain->epoch, epoch + 1);
+    releaseRetiredList(&domain->retired[(epoch + 1) % 3]);
+    domain->retiredSinceAdvance = 0;
+    return 1;
+}
+
+int
+retireObject(EpochDomain *domain, Pool *pool, void *object){
+    /**
+     * Return an object the writer has unlinked to its pool once no reader
+     * can see it anymore. Returns 0, having freed nothing, if the retired
+     * list cannot grow; the caller must then keep the object.
+     */
+    RetiredList *list = &domain->retired[atomic_load_explicit(&domain->epoch, memory_order_relaxed) % 3];
+    if(list->count == list->capacity){
+        size_t capacity = list->capacity > 0 ? list->capacity * 2 : 64;
+        RetiredObject *objects = realloc(list->objects, capacity * sizeof(RetiredObject));
+        if(objects == NULL){
+            return 0;
+        }
+        list->objects = objects;
+        list->capacity = capacity;
+    }
+    list->objects[list->count].pool = pool;
+    list->objects[list->count].object = object;
+    list->count++;
+    if(++domain->retiredSinceAdvance >= EPOCH_ADVANCE_INTERVAL){
+        tryAdvanceEpoch(domain);
+    }
+    return 1;
+}
+
+void
+releaseRetiredObjects(EpochDomain *domain){
+    /**
+     * Reclaim all retired objects now. Only call this while no reader is
+     * inside a read section.
+     */
+    int i;
+    for(i=0; i<3; i++){
+        releaseRetiredList(&domain->retired[i]);
+    }
+    domain->retiredSinceAdvance = 0;
+}
+
+int
+attachEpochDomain(Book *book, EpochDomain *domain){
+    /**
+     * Retire the limits and pooled orders the book removes through the
+     * given domain from now on, instead of freeing them right away.
+     *
+     * Return 0 for a book in ladder mode: its slots are reused in place
+     * when the window moves, which readers cannot be protected from.
+     */
+    if(book->buyLadder != NULL){
+        return 0;
+    }
+    book->epochs = domain;
+    return 1;
+}
+
+Limit*
+getFirstReadLimit(Book *book, unsigned buyOrSell){
+    /**
+     * Return the best limit of the given side for a reader inside a read
+     * section, or NULL if the side is empty.
+     */
+    Limit *root = buyOrSell == BUY ? book->buyTree : book->sellTree;
+    return getNextReadLimit(root, buyOrSell);
+}
+
+Limit*
+getNextReadLimit(Limit *limit, unsigned buyOrSell){
+    /**
+     * Return the next limit after the given one, away from the inside, for
+     * a reader inside a read section, or NULL at the end of the side.
+     *
+     * The end is the tree's root, told apart by its MIN_PRICE, which is
+     * never written again, rather than by its parent, which rotations do.
+     */
+    Limit *next = buyOrSell == BUY ? __atomic_load_n(&limit->prevLimit, __ATOMIC_ACQUIRE)
+                                   : __atomic_load_n(&limit->nextLimit, __ATOMIC_ACQUIRE);
+    if(next == NULL || next->limitPrice == MIN_PRICE){
+        return NULL;
+    }
+    return next;
+}
+
+void
+readLimitLevel(Limit *limit, DepthLevel *level){
+    /**
+     * Read the price, size and order count of a limit inside a read section.
+     */
+    __atomic_load(&limit->limitPrice, &level->price, __ATOMIC_RELAXED);
+    __atomic_load(&limit->size, &level->size, __ATOMIC_RELAXED);
+    level->orders = __atomic_load_n(&limit->orderCount, __ATOMIC_RELAXED);
+}
+
+Order*
+getFirstReadOrder(Limit *limit){
+    /**
+     * Return the newest order of a limit for a reader inside a read
+     * section; getNextReadOrder() walks on towards the oldest.
+     */
+    return __atomic_load_n(&limit->headOrder, __ATOMIC_ACQUIRE);
+}
+
+Order*
+getNextReadOrder(Order *order){
+    return __atomic_load_n(&order->nextOrder, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,222 @@
+/**
+ * Event Operations
+ *
+ * Apply batches of decoded feed events to a Book. While an event is
+ * applied, the memory of the events a few places ahead is prefetched in
+ * stages: the order id index slot, then the order, then its limit and
+ * queue neighbours, so that by the time an event is applied its cache
+ * lines are usually loaded. Random cancels in a deep book otherwise stall
+ * on each of these loads in turn.
+ *
+ * Each stage passes what it found on to the next in a small ring, so an
+ * id is hashed once and its slot read once; applying the event only
+ * checks that the slot still holds the id.
+ */
+
+#include <stdlib.h>
+#include "hftlob.h"
+
+#define EVENT_PREFETCH_DISTANCE 4
+/* Power of two holding the stages of the 3 * EVENT_PREFETCH_DISTANCE + 1 events in flight. */
+#define EVENT_STAGES 16
+
+
+/* What the prefetch stages found out about an event ahead. */
+typedef struct EventStage{
+    size_t slot;  /* home slot of the event's id in the order id index */
+    Order *order; /* the order the event names, if known yet */
+} EventStage;
+
+static int
+isLookedUp(Book *book, Event *event){
+    return event->order == NULL && event->type != EVENT_ADD && book->orders.slots != NULL;
+}
+
+static void
+stageEventSlot(Book *book, Event *event, EventStage *stage){
+    /**
+     * First stage: load the order, or the home slot of its id.
+     */
+    stage->order = event->order;
+    if(event->order != NULL){
+        __builtin_prefetch(event->order, 1);
+    }
+    else if(isLookedUp(book, event)){
+        stage->slot = getOrderMapHomeSlot(&book->orders, event->id);
+        __builtin_prefetch(&book->orders.slots[stage->slot]);
+    }
+}
+
+static void
+stageEventOrder(Book *book, Event *event, EventStage *stage){
+    /**
+     * Second stage: read the slot loaded by the first, and load the order
+     * it holds. An id which is not in its home slot is left to the full
+     * lookup when the event is applied.
+     */
+    if(isLookedUp(book, event)){
+        stage->order = getOrderInMapSlot(&book->orders, stage->slot, event->id);
+        if(stage->order != NULL){
+            __builtin_prefetch(stage->order, 1);
+        }
+    }
+}
+
+static void
+stageEventLimit(Book *book, Event *event, EventStage *stage){
+    /**
+     * Third stage: load the limit the event changes, and the neighbours a
+     * removal relinks.
+     *
+     * The events before this one may have moved the order since the second
+     * stage; then these are wasted prefetches, as the order is looked up
+     * again when the event is applied.
+     */
+    Order *order = stage->order;
+    if(event->type == EVENT_ADD){
+        unsigned buyOrSell = order != NULL ? order->buyOrSell : event->buyOrSell;
+        Ladder *ladder = buyOrSell == BUY ? book->buyLadder : book->sellLadder;
+        if(ladder != NULL){
+            Limit *slot = getLadderLimit(ladder, order != NULL ? order->limit : event->price);
+            if(slot != NULL){
+                __builtin_prefetch(slot, 1);
+            }
+        }
+        return;
+    }
+    if(order == NULL){
+        return;
+    }
+    if(order->parentLimit != NULL){
+        __builtin_prefetch(order->parentLimit, 1);
+    }
+    if(order->prevOrder != NULL){
+        __builtin_prefetch(order->prevOrder, 1);
+    }
+    if(order->nextOrder != NULL){
+        __builtin_prefetch(order->nextOrder, 1);
+    }
+}
+
+static Order*
+getEventOrder(Book *book, Event *event, EventStage *stage){
+    /**
+     * Return the order the event names. An id is first checked against
+     * its staged slot, which is already loaded, and only looked up in full
+     * if the events before moved it.
+     */
+    if(!isLookedUp(book, event)){
+        return event->order;
+    }
+    Order *order = getOrderInMapSlot(&book->orders, stage->slot, event->id);
+    if(order == NULL){
+        order = getFromOrderMap(&book->orders, event->id);
+    }
+    return order;
+}
+
+static int
+addEventOrder(Book *book, Event *event){
+    /**
+     * Add the order an event gives by value, in an order from the book's
+     * pool.
+     */
+    Order *order = allocateOrder(book);
+    if(order == NULL){
+        return 0;
+    }
+    order->id = event->id;
+    order->buyOrSell = event->buyOrSell;
+    order->limit = event->price;
+    order->shares = event->shares;
+    order->fromEvent = 1;
+    int result = addOrder(book, order);
+    if(result != 1){
+        releaseOrder(book, order);
+    }
+    return result;
+}
+
+static int
+applyEvent(Book *book, Event *event, EventStage *stage){
+    /**
+     * Apply one event. An order added by value is released to the pool once
+     * an event takes it out of the book; all other orders are the caller's.
+     */
+    if(event->type == EVENT_ADD && event->order == NULL){
+        return addEventOrder(book, event);
+    }
+    Order *order = getEventOrder(book, event, stage);
+    int result = 0;
+    if(order == NULL){
+        return 0;
+    }
+    switch(event->type){
+        case EVENT_ADD:
+            return addOrder(book, order);
+        case EVENT_CANCEL:
+            result = cancelOrder(book, order);
+            break;
+        case EVENT_MODIFY:
+            result = modifyOrder(book, order, event->price, event->shares);
+            break;
+        case EVENT_EXECUTE:
+            result = executeOrderShares(book, order, event->shares);
+            break;
+    }
+    if(order->fromEvent && order->parentLimit == NULL){
+        releaseOrder(book, order);
+    }
+    return result;
+}
+
+size_t
+applyEvents(Book *book, Event *events, size_t count, TopOfBook *top){
+    /**
+     * Apply the given events to the book in order, setting each event's
+     * result to the return code of its operation. Returns the number of
+     * events which failed.
+     *
+     * Orders added by value live in the book's pool, and are released
+     * again once an event takes them out of the book. Orders added by
+     * pointer stay the caller's, even if they come from allocateOrder().
+     *
+     * The top of book summary is taken once, after the whole batch, if top
+     * is not NULL.
+     */
+    EventStage stages[EVENT_STAGES];
+    size_t failed = 0;
+    size_t i;
+    /* Fill the pipeline, so that the first events are staged like the rest. */
+    for(i=0; i<count && i<3 * EVENT_PREFETCH_DISTANCE; i++){
+        stageEventSlot(book, &events[i], &stages[i]);
+    }
+    for(i=0; i<count && i<2 * EVENT_PREFETCH_DISTANCE; i++){
+        stageEventOrder(book, &events[i], &stages[i]);
+    }
+    for(i=0; i<count && i<EVENT_PREFETCH_DISTANCE; i++){
+        stageEventLimit(book, &events[i], &stages[i]);
+    }
+    for(i=0; i<count; i++){
+        size_t ahead = i + 3 * EVENT_PREFETCH_DISTANCE;
+        if(ahead < count){
+            stageEventSlot(book, &events[ahead], &stages[ahead % EVENT_STAGES]);
+        }
+        ahead = i + 2 * EVENT_PREFETCH_DISTANCE;
+        if(ahead < count){
+            stageEventOrder(book, &events[ahead], &stages[ahead % EVENT_STAGES]);
+        }
+        ahead = i + EVENT_PREFETCH_DISTANCE;
+        if(ahead < count){
+            stageEventLimit(book, &events[ahead], &stages[ahead % EVENT_STAGES]);
+        }
+        events[i].result = applyEvent(book, &events[i], &stages[i % EVENT_STAGES]);
+        if(events[i].result != 1){
+            failed++;
+        }
+    }
+    if(top != NULL){
+        getTopOfBook(book, top);
+    }
+    return failed;
+}
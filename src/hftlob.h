@@ -1,34 +1,493 @@
 #ifndef HFTLOB_H_
 #define HFTLOB_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+/**
+ * PRICE AND QUANTITY TYPES
+ *
+ * By default prices and quantities are doubles. Building with
+ * HFTLOB_FIXED_POINT defined switches them to integer ticks and lots;
+ * use an Instrument to convert at the edges.
+ */
+
+#ifdef HFTLOB_FIXED_POINT
+typedef int64_t Price;    /* in ticks */
+typedef int64_t Quantity; /* in lots */
+typedef int64_t Volume;   /* in ticks times lots */
+#define MIN_PRICE INT64_MIN
+#define MAX_PRICE INT64_MAX
+#else
+#include <math.h>
+typedef double Price;
+typedef double Quantity;
+typedef double Volume;
+#define MIN_PRICE (-INFINITY)
+#define MAX_PRICE INFINITY
+#endif
+
 /**
  * CUSTOM STRUCTS
  */
 
+/* Values for Order.buyOrSell */
+#define SELL 0
+#define BUY 1
+
+/**
+ * Orders and limits keep the fields the book touches on every add, cancel
+ * and execution up front: an Order fits into one 64 byte cache line, and
+ * a Limit's queue and size fields come before its tree links, which only
+ * limits in the trees use.
+ */
 typedef struct Order{
-    char *tid;
-    unsigned buyOrSell;
-    double shares;
-    double limit;
-    double entryTime;
-    double eventTime;
+    uint64_t id;
+    Quantity shares;
+    Price limit;
     struct Order *nextOrder;
     struct Order *prevOrder;
     struct Limit *parentLimit;
-    int exchangeId;
+    unsigned buyOrSell;
+    uint32_t queueRank; /* arrival rank in the limit's QueueIndex, if any */
+    int fromEvent;      /* added by value through applyEvents(), which releases it */
 } Order;
 
+/* Order fields the book never reads, kept apart from the Order; see getOrderMeta(). */
+typedef struct OrderMeta{
+    char *tid;
+    double entryTime;
+    double eventTime;
+    int exchangeId;
+} OrderMeta;
+
+/**
+ * Fenwick trees over the shares and order counts of a limit's orders, by
+ * arrival rank, for getQueuePosition(). Node 0 is unused.
+ */
+typedef struct QueueIndexNode{
+    Quantity shares;
+    int64_t orders;
+} QueueIndexNode;
+
+typedef struct QueueIndex{
+    QueueIndexNode *nodes;
+    uint32_t capacity; /* highest rank the nodes hold */
+    uint32_t nextRank; /* rank of the next order to join */
+} QueueIndex;
+
 typedef struct Limit{
-    double limitPrice;
-    double size;
-    double totalVolume;
+    Price limitPrice;
+    Quantity size;
+    Volume totalVolume;
+    struct Order *headOrder;
+    struct Order *tailOrder;
+    QueueIndex *queueIndex; /* built by the first getQueuePosition() */
     int orderCount;
+    int height;
+    Quantity subtreeSize;  /* size of this limit and all limits below it */
+    Volume subtreeVolume;  /* likewise for totalVolume */
     struct Limit *parent;
     struct Limit *leftChild;
     struct Limit *rightChild;
-    struct Order *headOrder;
-    struct Order *tailOrder;
+    struct Limit *nextLimit; /* in-order links; a tree's root heads the list */
+    struct Limit *prevLimit;
 } Limit;
 
+/* Open-addressing (Robin Hood) map from Order.id to Order. */
+typedef struct OrderMapSlot{
+    uint64_t id;
+    Order *order; /* NULL if the slot is empty */
+} OrderMapSlot;
+
+typedef struct OrderMap{
+    OrderMapSlot *slots;
+    size_t capacity; /* always a power of two */
+    size_t count;
+    size_t maxCount; /* inserts fail rather than rehash beyond this */
+    int shift;
+} OrderMap;
+
+/* Interning map from Order.tid strings to 64 bit order ids. */
+typedef struct TidMapSlot{
+    uint64_t hash;
+    const char *tid; /* NULL if the slot is empty; not copied */
+    uint64_t id;
+} TidMapSlot;
+
+typedef struct TidMap{
+    TidMapSlot *slots;
+    size_t capacity;
+    size_t count;
+    size_t maxCount;
+    uint64_t nextId;
+} TidMap;
+
+/* Per-instrument tick and lot size, used to convert to and from Price and Quantity. */
+typedef struct Instrument{
+    double tickSize;
+    double lotSize;
+} Instrument;
+
+/**
+ * Hierarchical occupancy bitmap. Level 0 holds one bit per index; every
+ * bit of a higher level is set iff the corresponding word below is not
+ * zero. The top level is a single word.
+ */
+#define BITMAP_MAX_LEVELS 4
+
+typedef struct Bitmap{
+    uint64_t *words[BITMAP_MAX_LEVELS];
+    int levels;
+    size_t size; /* number of bits in level 0 */
+} Bitmap;
+
+/**
+ * Dense ring of limits for the prices in a window of consecutive ticks.
+ * A price's slot is its tick index modulo the capacity; a slot holds a
+ * limit of the book iff its headOrder is not NULL.
+ */
+typedef struct Ladder{
+    Limit *slots;
+    size_t capacity; /* always a power of two */
+    size_t count;    /* number of non-empty slots */
+    Price tickSize;
+    int64_t baseTick; /* tick index of the lowest price in the window */
+    Bitmap occupied;  /* bit i is set iff slots[i] is non-empty */
+} Ladder;
+
+/**
+ * Fixed-size object pool. Objects come from slabs, the first one holding
+ * slabObjects objects; free objects are chained through their first word.
+ */
+#define POOL_HUGE_PAGES 1    /* back slabs with huge pages where available */
+#define POOL_CACHE_ALIGNED 2 /* start every object on a cache line */
+#define POOL_HANDLES 4       /* keep generations for getPoolHandle() */
+
+/* A handle holds the slot in its low bits and the generation above. */
+#define POOL_HANDLE_SLOT_BITS 32
+#define POOL_HANDLE_MAX_SLOTS ((uint64_t)1 << POOL_HANDLE_SLOT_BITS)
+#define INVALID_HANDLE UINT64_MAX
+
+typedef struct Pool{
+    void *freeList;
+    size_t objectSize;
+    size_t slabObjects;
+    void **slabs;
+    size_t slabCount;
+    size_t slabCapacity;
+    size_t count; /* number of objects handed out */
+    int flags;
+    uint32_t *generations; /* per slot, only with POOL_HANDLES */
+} Pool;
+
+/* One level of a side's depth; see initBookDepth(). */
+typedef struct DepthLevel{
+    Price price;
+    Quantity size;
+    int orders;
+} DepthLevel;
+
+typedef struct Depth{
+    DepthLevel *levels; /* best level first */
+    int capacity;
+    int count;
+} Depth;
+
+typedef struct Book{
+    struct Limit *buyTree;
+    struct Limit *sellTree;
+    struct Limit *lowestSell;
+    struct Limit *highestBuy;
+    OrderMap orders; /* only used after reserveOrders() */
+    Ladder *buyLadder; /* only used after initLadders() */
+    Ladder *sellLadder;
+    Pool limitPool; /* all limits of the book, including both roots */
+    Pool orderPool; /* orders from allocateOrder() */
+    OrderMeta *orderMeta; /* indexed by the order's slot in orderPool */
+    size_t orderMetaCapacity;
+    Depth buyDepth; /* only used after initBookDepth() */
+    Depth sellDepth;
+    struct BookSnapshot *snapshot; /* only used after attachBookSnapshot() */
+    struct EpochDomain *epochs;    /* only used after attachEpochDomain() */
+    int rangeTotals; /* subtree totals kept up to date; see enableRangeTotals() */
+} Book;
+
+/* Order types for submitOrder() */
+#define ORDER_LIMIT 0  /* match, then rest the remainder */
+#define ORDER_IOC 1    /* match up to the limit price, cancel the remainder */
+#define ORDER_FOK 2    /* match completely up to the limit price, or not at all */
+#define ORDER_MARKET 3 /* match at any price, cancel the remainder */
+
+/* A trade between an incoming (taker) order and a resting (maker) order. */
+typedef struct Fill{
+    uint64_t takerId;
+    uint64_t makerId;
+    Order *maker;
+    Price price;
+    Quantity shares;
+    int makerFilled; /* the maker was filled completely and left the book */
+} Fill;
+
+/* Summary of the inside of a Book; see getTopOfBook(). */
+typedef struct TopOfBook{
+    Price bidPrice;
+    Quantity bidSize;
+    int bidOrders;
+    Price askPrice;
+    Quantity askSize;
+    int askOrders;
+} TopOfBook;
+
+/* Number of levels per side in a BookSnapshot. */
+#define SNAPSHOT_LEVELS 5
+
+/* What a BookSnapshot holds; see readBookSnapshot(). */
+typedef struct BookSnapshotData{
+    TopOfBook top;
+    int bidLevels;
+    int askLevels;
+    DepthLevel bids[SNAPSHOT_LEVELS]; /* best level first */
+    DepthLevel asks[SNAPSHOT_LEVELS];
+} BookSnapshotData;
+
+#define SNAPSHOT_WORDS ((sizeof(BookSnapshotData) + 7) / 8)
+
+/**
+ * Seqlock-published copy of a book's inside, written by the thread
+ * changing the book and read by any number of others.
+ */
+typedef struct BookSnapshot{
+    _Alignas(64) atomic_uint sequence; /* odd while a publication is under way */
+    atomic_uint_least64_t words[SNAPSHOT_WORDS];
+    _Alignas(64) BookSnapshotData published; /* the writer's own copy */
+} BookSnapshot;
+
+/**
+ * Epoch-based reclamation for readers walking a book concurrently; see
+ * enterEpoch(). A reader slot holds the epoch its reader entered in, or 0.
+ */
+#define EPOCH_MAX_READERS 64
+
+typedef struct EpochReader{
+    _Alignas(64) atomic_uint_fast64_t epoch;
+    atomic_int used;
+} EpochReader;
+
+typedef struct RetiredObject{
+    Pool *pool;
+    void *object;
+} RetiredObject;
+
+typedef struct RetiredList{
+    RetiredObject *objects;
+    size_t count;
+    size_t capacity;
+} RetiredList;
+
+typedef struct EpochDomain{
+    _Alignas(64) atomic_uint_fast64_t epoch;
+    EpochReader readers[EPOCH_MAX_READERS];
+    RetiredList retired[3]; /* by epoch modulo 3; writer only */
+    size_t retiredSinceAdvance;
+} EpochDomain;
+
+/* Values for Event.type */
+#define EVENT_ADD 0     /* add event.order */
+#define EVENT_CANCEL 1  /* cancel the order */
+#define EVENT_MODIFY 2  /* modify the order to event.price and event.shares */
+#define EVENT_EXECUTE 3 /* execute event.shares of the order */
+
+/**
+ * A decoded feed event. Events name their order either by pointer, or by
+ * id with order set to NULL; the latter needs the book's order id index.
+ * An add with order set to NULL gives the order by value instead, as id,
+ * buyOrSell, price and shares, and the book takes it from its own pool.
+ */
+typedef struct Event{
+    int type;
+    uint64_t id;
+    Order *order;
+    unsigned buyOrSell; /* side of an add given by value */
+    Price price;
+    Quantity shares;
+    int result; /* return code of the operation, set by applyEvents() */
+    uint32_t instrument; /* instrument id, for dispatchEvents() */
+} Event;
+
+/**
+ * A recorded feed message in a replay file; see openReplayFile(). The type
+ * is one of the Event.type values. Prices are in ticks and sizes in lots
+ * of the replaying instrument, and all fields are in host byte order.
+ */
+typedef struct ReplayRecord{
+    uint8_t type;
+    uint8_t buyOrSell;
+    uint8_t reserved[6];
+    uint64_t id;
+    int64_t price;
+    int64_t shares;
+} ReplayRecord;
+
+/* Replay files start with this header, followed by recordCount records. */
+#define REPLAY_MAGIC "HLOBRPL1"
+typedef struct ReplayHeader{
+    char magic[8];
+    uint32_t recordSize; /* sizeof(ReplayRecord) */
+    uint32_t reserved;
+    uint64_t recordCount;
+} ReplayHeader;
+
+/* A replay file mapped into memory; records point into the mapping. */
+typedef struct ReplayFile{
+    const void *map;
+    size_t mapSize;
+    const ReplayRecord *records;
+    size_t count;
+} ReplayFile;
+
+/* ITCH 5.0 message types the decoder applies to books; see decodeItchMessage(). */
+#define ITCH_ADD 'A'                 /* add order */
+#define ITCH_ADD_ATTRIBUTED 'F'      /* add order with MPID attribution */
+#define ITCH_EXECUTE 'E'             /* order executed */
+#define ITCH_EXECUTE_WITH_PRICE 'C'  /* order executed at a price other than its own */
+#define ITCH_CANCEL 'X'              /* part of the order cancelled */
+#define ITCH_DELETE 'D'              /* order deleted */
+#define ITCH_REPLACE 'U'             /* order replaced by one with a new reference */
+
+/* ITCH prices have four implied decimals. */
+#define ITCH_PRICE_SCALE 10000
+/* Largest framed message of the types above: length prefix and 'F'. */
+#define ITCH_MAX_FRAME 42
+
+/**
+ * The fields of one ITCH order message, for encodeItchMessage(). Fields a
+ * type does not carry are ignored: newReference is only used by replaces,
+ * side only by adds, and price by adds, replaces and executions with price.
+ */
+typedef struct ItchMessage{
+    char type;
+    uint16_t stockLocate;
+    uint64_t timestamp; /* nanoseconds since midnight, 48 bits */
+    uint64_t reference;
+    uint64_t newReference;
+    char side;          /* 'B' or 'S' */
+    uint32_t shares;
+    uint32_t price;     /* in 1/ITCH_PRICE_SCALE */
+} ItchMessage;
+
+/* An absolute size for one price level of an L2 feed; a size of 0 removes it. */
+typedef struct LevelUpdate{
+    unsigned buyOrSell;
+    Price price;
+    Quantity size;
+} LevelUpdate;
+
+/* Level updates a DepthFeed collects before applying them to its book. */
+#define DEPTH_FEED_MAX_UPDATES 256
+
+/**
+ * Applies JSON depth messages with decimal string prices and sizes to an
+ * L2 book; see applyDepthMessage(). Prices are parsed into ticks of
+ * 10^-priceDecimals and sizes into lots of 10^-sizeDecimals.
+ */
+typedef struct DepthFeed{
+    Book *book;
+    Instrument instrument;
+    int priceDecimals;
+    int sizeDecimals;
+    size_t updateCount;
+    size_t failed; /* level updates of the current message the book rejected */
+    LevelUpdate updates[DEPTH_FEED_MAX_UPDATES];
+} DepthFeed;
+
+/* Latency histogram buckets: 16 per power of two of nanoseconds. */
+#define REPLAY_LATENCY_SUB_BUCKETS 16
+#define REPLAY_LATENCY_BUCKETS (64 * REPLAY_LATENCY_SUB_BUCKETS)
+
+/* Results of replayBook(). */
+typedef struct ReplayStats{
+    size_t messages;
+    size_t failed;       /* messages whose book operation did not return 1 */
+    long long elapsedNs; /* wall clock time of the whole replay */
+    long long maxLatencyNs;
+    uint64_t latencies[REPLAY_LATENCY_BUCKETS];
+} ReplayStats;
+
+/**
+ * How a registry sets up the book of an instrument; see registerInstrument().
+ * LIQUID_TIER, ACTIVE_TIER and ILLIQUID_TIER cover the usual cases.
+ */
+typedef struct BookTier{
+    size_t expectedLimits; /* tree limits to reserve in the limit pool */
+    size_t expectedOrders; /* sizes the order id index and order pool */
+    size_t ladderTicks;    /* ladder window per side, 0 for trees only */
+    int lazy;              /* create the book on the first order only, and
+                            * grow its pools from empty as orders arrive */
+} BookTier;
+
+typedef struct RegistryEntry{
+    Instrument instrument;
+    const BookTier *tier; /* NULL if no instrument has this id */
+    Book *book;
+} RegistryEntry;
+
+typedef struct BookRegistry{
+    RegistryEntry *entries; /* indexed by instrument id */
+    uint32_t capacity;
+    uint32_t bookCount;     /* books created so far */
+} BookRegistry;
+
+extern const BookTier LIQUID_TIER;
+extern const BookTier ACTIVE_TIER;
+extern const BookTier ILLIQUID_TIER;
+
+/**
+ * Lock-free single-producer/single-consumer ring of events. The indexes
+ * only grow; the producer's and the consumer's sit on cache lines of
+ * their own, each next to its owner's copy of the other index.
+ */
+typedef struct SpscRing{
+    Event *slots;
+    size_t mask; /* slot count minus one; the count is a power of two */
+    _Alignas(64) atomic_size_t head; /* next event to pop */
+    size_t cachedTail;
+    _Alignas(64) atomic_size_t tail; /* next slot to push to */
+    size_t cachedHead;
+} SpscRing;
+
+/* Values for EngineConfig.waitPolicy */
+#define ENGINE_BUSY_POLL 0 /* spin on an empty ring */
+#define ENGINE_BACKOFF 1   /* spin, then yield, then sleep */
+
+typedef struct EngineConfig{
+    int workerCount;
+    size_t ringCapacity; /* events per worker ring */
+    size_t batchSize;    /* events a worker applies at once */
+    int waitPolicy;
+    int firstCpu;        /* pin worker i to core firstCpu + i; -1 to not pin */
+} EngineConfig;
+
+typedef struct EngineWorker{
+    SpscRing ring;
+    BookRegistry registry; /* books of the instruments this worker owns */
+    pthread_t thread;
+    struct Engine *engine;
+    int index;
+    atomic_uint_fast64_t processed; /* events applied */
+    atomic_uint_fast64_t failed;    /* events which failed */
+    Event *batch;                   /* config.batchSize events, for the thread */
+} EngineWorker;
+
+typedef struct Engine{
+    EngineWorker *workers;
+    EngineConfig config;
+    atomic_int running;
+    int started;
+} Engine;
+
 typedef struct QueueItem{
     Limit *limit;
     struct QueueItem *previous;
@@ -38,6 +497,7 @@ typedef struct Queue{
     int size;
     QueueItem *head;
     QueueItem *tail;
+    Pool *itemPool; /* items are malloc'ed if NULL */
 } Queue;
 
 /**
@@ -46,9 +506,15 @@ typedef struct Queue{
 void
 initOrder(Order *order);
 
+void
+initOrderMeta(OrderMeta *meta);
+
 void
 initLimit(Limit *limit);
 
+int
+initBook(Book *book);
+
 void
 initQueueItem(QueueItem *item);
 
@@ -56,10 +522,29 @@ void
 initQueue(Queue *q);
 
 /**
- * QUEUE FUNCTIONS
+ * INSTRUMENT FUNCTIONS
  */
 
 void
+initInstrument(Instrument *instrument, double tickSize, double lotSize);
+
+Price
+toPrice(const Instrument *instrument, double price);
+
+double
+fromPrice(const Instrument *instrument, Price price);
+
+Quantity
+toQuantity(const Instrument *instrument, double quantity);
+
+double
+fromQuantity(const Instrument *instrument, Quantity quantity);
+
+/**
+ * QUEUE FUNCTIONS
+ */
+
+int
 pushToQueue(Queue *q, Limit *limit);
 
 Limit*
@@ -68,6 +553,99 @@ popFromQueue(Queue *q);
 int
 queueIsEmpty(Queue *q);
 
+/**
+ * POOL FUNCTIONS
+ */
+
+int
+initPool(Pool *pool, size_t objectSize, size_t capacity, int flags);
+
+void
+destroyPool(Pool *pool);
+
+void*
+allocFromPool(Pool *pool);
+
+void
+freeToPool(Pool *pool, void *object);
+
+size_t
+getPoolCapacity(Pool *pool);
+
+size_t
+getPoolSlot(Pool *pool, const void *object);
+
+void*
+getPoolObject(Pool *pool, size_t slot);
+
+uint64_t
+getPoolHandle(Pool *pool, const void *object);
+
+void*
+getPoolObjectByHandle(Pool *pool, uint64_t handle);
+
+/**
+ * BITMAP FUNCTIONS
+ */
+
+int
+initBitmap(Bitmap *bitmap, size_t size);
+
+void
+destroyBitmap(Bitmap *bitmap);
+
+void
+setBitmapBit(Bitmap *bitmap, size_t index);
+
+void
+clearBitmapBit(Bitmap *bitmap, size_t index);
+
+int64_t
+findBitmapBitAtOrBelow(Bitmap *bitmap, int64_t index);
+
+int64_t
+findBitmapBitAtOrAbove(Bitmap *bitmap, int64_t index);
+
+/**
+ * ORDER MAP FUNCTIONS
+ */
+
+int
+initOrderMap(OrderMap *map, size_t expectedOrders);
+
+void
+destroyOrderMap(OrderMap *map);
+
+int
+insertIntoOrderMap(OrderMap *map, Order *order);
+
+size_t
+getOrderMapHomeSlot(OrderMap *map, uint64_t id);
+
+Order*
+getOrderInMapSlot(OrderMap *map, size_t index, uint64_t id);
+
+Order*
+getFromOrderMap(OrderMap *map, uint64_t id);
+
+Order*
+removeFromOrderMap(OrderMap *map, uint64_t id);
+
+int
+initTidMap(TidMap *map, size_t expectedTids);
+
+void
+destroyTidMap(TidMap *map);
+
+uint64_t
+internTid(TidMap *map, const char *tid);
+
+uint64_t
+lookupTid(TidMap *map, const char *tid);
+
+uint64_t
+releaseTid(TidMap *map, const char *tid);
+
 /**
  * ORDER FUNCTIONS
  */
@@ -81,6 +659,384 @@ popOrder(Limit *limit);
 int
 removeOrder(Order *order);
 
+int
+reduceOrder(Order *order, Quantity shares);
+
+int
+getQueuePosition(Order *order, Quantity *sharesAhead, int *ordersAhead);
+
+void
+destroyQueueIndex(Limit *limit);
+
+/**
+ * BOOK FUNCTIONS
+ */
+
+int
+limitIsBetter(unsigned buyOrSell, Price price, Limit *limit);
+
+int
+addOrder(Book *book, Order *order);
+
+int
+cancelOrder(Book *book, Order *order);
+
+int
+modifyOrder(Book *book, Order *order, Price price, Quantity shares);
+
+Order*
+executeOrder(Book *book, unsigned buyOrSell);
+
+int
+reserveOrders(Book *book, size_t expectedOrders);
+
+Order*
+getOrderById(Book *book, uint64_t id);
+
+Order*
+cancelOrderById(Book *book, uint64_t id);
+
+int
+executeOrderShares(Book *book, Order *order, Quantity shares);
+
+Order*
+executeOrderById(Book *book, uint64_t id, Quantity shares);
+
+int
+reservePools(Book *book, size_t expectedLimits, size_t expectedOrders, int flags);
+
+Order*
+allocateOrder(Book *book);
+
+void
+releaseOrder(Book *book, Order *order);
+
+OrderMeta*
+getOrderMeta(Book *book, Order *order);
+
+uint64_t
+getOrderHandle(Book *book, Order *order);
+
+Order*
+getOrderByHandle(Book *book, uint64_t handle);
+
+int
+initLadders(Book *book, Price tickSize, size_t capacity);
+
+Limit*
+findBookLimit(Book *book, unsigned buyOrSell, Price price);
+
+int
+recenterBookSide(Book *book, unsigned buyOrSell, Price price);
+
+Limit*
+getNextBookLimit(Book *book, Limit *limit, unsigned buyOrSell);
+
+Limit*
+getBestBid(Book *book);
+
+Limit*
+getBestOffer(Book *book);
+
+void
+getTopOfBook(Book *book, TopOfBook *top);
+
+void
+enableRangeTotals(Book *book);
+
+Quantity
+getBookSizeBetween(Book *book, unsigned buyOrSell, Price low, Price high, Volume *volume);
+
+void
+removeEmptyLimit(Book *book, Limit *limit, unsigned buyOrSell);
+
+void
+destroyLimitTree(Limit *limit);
+
+void
+destroyBook(Book *book);
+
+/**
+ * MATCHING FUNCTIONS
+ */
+
+size_t
+matchOrder(Book *book, Order *order, Fill *fills, size_t maxFills);
+
+Quantity
+getFillableShares(Book *book, unsigned buyOrSell, Price limit, Quantity shares, size_t *maxFillsNeeded);
+
+int
+submitOrder(Book *book, Order *order, int orderType, Fill *fills, size_t maxFills, size_t *fillCount);
+
+/**
+ * DEPTH FUNCTIONS
+ */
+
+int
+initBookDepth(Book *book, int levels);
+
+void
+destroyBookDepth(Book *book);
+
+void
+updateBookDepth(Book *book, unsigned buyOrSell, Price price, Limit *limit);
+
+int
+copyBookDepth(Book *book, unsigned buyOrSell, DepthLevel *levels, int maxLevels);
+
+/**
+ * SNAPSHOT FUNCTIONS
+ */
+
+void
+initBookSnapshot(BookSnapshot *snapshot);
+
+void
+attachBookSnapshot(Book *book, BookSnapshot *snapshot);
+
+void
+publishBookSnapshot(Book *book);
+
+int
+noteSnapshotChange(Book *book, unsigned buyOrSell, Price price);
+
+int
+tryReadBookSnapshot(BookSnapshot *snapshot, BookSnapshotData *data);
+
+void
+readBookSnapshot(BookSnapshot *snapshot, BookSnapshotData *data);
+
+/**
+ * EPOCH FUNCTIONS
+ */
+
+void
+initEpochDomain(EpochDomain *domain);
+
+void
+destroyEpochDomain(EpochDomain *domain);
+
+int
+registerEpochReader(EpochDomain *domain);
+
+void
+unregisterEpochReader(EpochDomain *domain, int reader);
+
+void
+enterEpoch(EpochDomain *domain, int reader);
+
+void
+leaveEpoch(EpochDomain *domain, int reader);
+
+int
+tryAdvanceEpoch(EpochDomain *domain);
+
+int
+retireObject(EpochDomain *domain, Pool *pool, void *object);
+
+void
+releaseRetiredObjects(EpochDomain *domain);
+
+int
+attachEpochDomain(Book *book, EpochDomain *domain);
+
+Limit*
+getFirstReadLimit(Book *book, unsigned buyOrSell);
+
+Limit*
+getNextReadLimit(Limit *limit, unsigned buyOrSell);
+
+void
+readLimitLevel(Limit *limit, DepthLevel *level);
+
+Order*
+getFirstReadOrder(Limit *limit);
+
+Order*
+getNextReadOrder(Order *order);
+
+/**
+ * EVENT FUNCTIONS
+ */
+
+size_t
+applyEvents(Book *book, Event *events, size_t count, TopOfBook *top);
+
+/**
+ * REPLAY FUNCTIONS
+ */
+
+int
+mapInputFile(const char *path, const void **data, size_t *size);
+
+void
+unmapInputFile(const void *data, size_t size);
+
+int
+openReplayFile(ReplayFile *file, const char *path);
+
+void
+closeReplayFile(ReplayFile *file);
+
+int
+writeReplayFile(const char *path, const ReplayRecord *records, size_t count);
+
+int
+applyReplayRecord(Book *book, const Instrument *instrument, const ReplayRecord *record);
+
+size_t
+countReplayAdds(const ReplayFile *file);
+
+int
+replayBook(Book *book, const Instrument *instrument, const ReplayFile *file, ReplayStats *stats);
+
+long long
+getReplayLatency(const ReplayStats *stats, double percentile);
+
+/**
+ * ITCH FUNCTIONS
+ */
+
+size_t
+encodeItchMessage(const ItchMessage *message, uint8_t *buffer);
+
+int
+decodeItchMessage(BookRegistry *registry, const uint8_t *message, size_t length);
+
+size_t
+decodeItchBuffer(BookRegistry *registry, const uint8_t *buffer, size_t length, size_t *messages, size_t *failed);
+
+int
+decodeItchFile(BookRegistry *registry, const char *path, size_t *messages, size_t *failed);
+
+int
+writeItchSample(const char *path, uint16_t stockLocate, size_t messages, unsigned seed);
+
+/**
+ * JSON DEPTH FUNCTIONS
+ */
+
+int
+initDepthFeed(DepthFeed *feed, Book *book, int priceDecimals, int sizeDecimals);
+
+size_t
+applyLevelUpdates(Book *book, const LevelUpdate *updates, size_t count);
+
+int
+applyDepthMessage(DepthFeed *feed, const char *json, size_t length);
+
+size_t
+applyDepthStream(DepthFeed *feed, const char *buffer, size_t length, size_t *messages, size_t *failed);
+
+int
+applyDepthFile(DepthFeed *feed, const char *path, size_t *messages, size_t *failed);
+
+/**
+ * REGISTRY FUNCTIONS
+ */
+
+int
+initBookRegistry(BookRegistry *registry, uint32_t capacity);
+
+void
+destroyBookRegistry(BookRegistry *registry);
+
+int
+registerInstrument(BookRegistry *registry, uint32_t id, double tickSize, double lotSize, const BookTier *tier);
+
+Book*
+getInstrumentBook(BookRegistry *registry, uint32_t id, int create);
+
+size_t
+dispatchEvents(BookRegistry *registry, Event *events, size_t count);
+
+/**
+ * ENGINE FUNCTIONS
+ */
+
+int
+initSpscRing(SpscRing *ring, size_t capacity);
+
+void
+destroySpscRing(SpscRing *ring);
+
+int
+pushToSpscRing(SpscRing *ring, const Event *event);
+
+size_t
+popFromSpscRing(SpscRing *ring, Event *events, size_t maxEvents);
+
+void
+initEngineConfig(EngineConfig *config);
+
+int
+initEngine(Engine *engine, const EngineConfig *config, uint32_t instrumentCapacity);
+
+void
+destroyEngine(Engine *engine);
+
+EngineWorker*
+getEngineWorker(Engine *engine, uint32_t instrument);
+
+int
+registerEngineInstrument(Engine *engine, uint32_t id, double tickSize, double lotSize, const BookTier *tier);
+
+int
+startEngine(Engine *engine);
+
+void
+stopEngine(Engine *engine);
+
+int
+submitEngineEvent(Engine *engine, const Event *event);
+
+Book*
+getEngineBook(Engine *engine, uint32_t id);
+
+/**
+ * LADDER FUNCTIONS
+ */
+
+int
+initLadder(Ladder *ladder, Price tickSize, size_t capacity);
+
+void
+destroyLadder(Ladder *ladder);
+
+int64_t
+getLadderTick(Ladder *ladder, Price price);
+
+int
+snapToLadderGrid(Ladder *ladder, Price *price);
+
+Limit*
+getLadderLimit(Ladder *ladder, Price price);
+
+int
+ladderContains(Ladder *ladder, Limit *limit);
+
+void
+occupyLadderSlot(Ladder *ladder, Limit *slot, Price price);
+
+void
+vacateLadderSlot(Ladder *ladder, Limit *slot);
+
+Limit*
+getNextLadderLimit(Ladder *ladder, Limit *limit, unsigned buyOrSell);
+
+Quantity
+getLadderSizeBetween(Ladder *ladder, Price low, Price high, Volume *volume);
+
+int
+moveLadderWindow(Ladder *ladder, Limit *tree, Pool *limitPool, unsigned buyOrSell, int64_t baseTick);
+
+int
+ladderCoversInside(Ladder *ladder, unsigned buyOrSell, Price price);
+
+int64_t
+getLadderBaseTick(Ladder *ladder, unsigned buyOrSell, Price price);
+
 /**
  * BINARY SEARCH TREE FUNCTIONS
  */
@@ -88,6 +1044,9 @@ removeOrder(Order *order);
 Limit*
 createRoot(void);
 
+Limit*
+createPooledRoot(Pool *pool);
+
 int
 addNewLimit(Limit *root, Limit *limit);
 
@@ -97,6 +1056,12 @@ replaceLimitInParent(Limit *limit, Limit *newLimit);
 int
 removeLimit(Limit *limit);
 
+Quantity
+getSizeBetween(Limit *root, Price low, Price high, Volume *volume);
+
+Quantity
+walkSizeBetween(Limit *root, Price low, Price high, Volume *volume);
+
 /**
  * BINARY SEARCH TREE BALANCING FUNCTIONS
  */
@@ -104,6 +1069,9 @@ removeLimit(Limit *limit);
 void
 balanceBranch(Limit *limit);
 
+void
+retraceBalance(Limit *limit);
+
 void
 rotateLeftLeft(Limit *limit);
 
@@ -124,6 +1092,9 @@ rotateRightLeft(Limit *limit);
 int
 limitExists(Limit *root, Limit *limit);
 
+Limit*
+findLimit(Limit *root, Price price);
+
 int
 limitIsRoot(Limit *limit);
 
@@ -139,9 +1110,33 @@ getMinimumLimit(Limit *limit);
 Limit*
 getMaximumLimit(Limit *limit);
 
+Limit*
+getSuccessor(Limit *limit);
+
+Limit*
+getPredecessor(Limit *limit);
+
 int
 getHeight(Limit *limit);
 
+void
+updateHeight(Limit *limit);
+
+void
+retraceHeight(Limit *limit);
+
+void
+updateSubtreeTotals(Limit *limit);
+
+void
+retraceSubtreeTotals(Limit *limit);
+
+void
+adjustSubtreeTotals(Limit *limit, Quantity size, Volume volume);
+
+void
+rebuildSubtreeTotals(Limit *limit);
+
 int
 getBalanceFactor(Limit *limit);
 
@@ -154,4 +1149,10 @@ copyLimit(Limit *ptr_src, Limit *ptr_tar);
 
 void RunAllTests(void);
 
+/**
+ * Benchmark Functions
+ * */
+
+void RunAllBenchmarks(void);
+
 #endif
\ No newline at end of file
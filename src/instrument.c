@@ -0,0 +1,56 @@
+/**
+ * Instrument Operations
+ *
+ * Conversions between external decimal prices and quantities and the
+ * book's Price and Quantity types. In fixed point builds these are integer
+ * ticks and lots; otherwise they are doubles rounded to the tick and lot
+ * grid, so that equal prices compare equal in the limit trees.
+ */
+
+#include <math.h>
+#include "hftlob.h"
+
+
+void
+initInstrument(Instrument *instrument, double tickSize, double lotSize){
+    instrument->tickSize = tickSize;
+    instrument->lotSize = lotSize;
+}
+
+Price
+toPrice(const Instrument *instrument, double price){
+#ifdef HFTLOB_FIXED_POINT
+    return llround(price / instrument->tickSize);
+#else
+    return round(price / instrument->tickSize) * instrument->tickSize;
+#endif
+}
+
+double
+fromPrice(const Instrument *instrument, Price price){
+#ifdef HFTLOB_FIXED_POINT
+    return price * instrument->tickSize;
+#else
+    (void)instrument;
+    return price;
+#endif
+}
+
+Quantity
+toQuantity(const Instrument *instrument, double quantity){
+#ifdef HFTLOB_FIXED_POINT
+    return llround(quantity / instrument->lotSize);
+#else
+    return round(quantity / instrument->lotSize) * instrument->lotSize;
+#endif
+}
+
+double
+fromQuantity(const Instrument *instrument, Quantity quantity){
+#ifdef HFTLOB_FIXED_POINT
+    return quantity * instrument->lotSize;
+#else
+    (void)instrument;
+    return quantity;
+#endif
+}
@@ -0,0 +1,349 @@
+/**
+ * ITCH Operations
+ *
+ * Decode NASDAQ ITCH 5.0 order messages straight into book operations on
+ * the books of a BookRegistry, with a message's stock locate as instrument
+ * id. Fields are read big-endian from the buffer where they lie; nothing
+ * is copied or allocated per message, as adds take their orders from the
+ * book's order pool and all other messages find their order by reference
+ * in the book's order id index.
+ *
+ * Buffers and files hold messages framed by a 2 byte big-endian length,
+ * as in NASDAQ's binary files. Message types other than the order
+ * messages are skipped. Prices are converted with the instrument's tick
+ * size, so instruments are best registered with a tick size of 0.0001 or
+ * a multiple of it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "hftlob.h"
+
+#define ITCH_SAMPLE_LIVE_ORDERS 1024
+
+
+static size_t
+getItchLength(char type){
+    /**
+     * Return the length of an order message of the given type without its
+     * length prefix, or 0 for the types the decoder skips.
+     */
+    switch(type){
+        case ITCH_ADD: return 36;
+        case ITCH_ADD_ATTRIBUTED: return 40;
+        case ITCH_EXECUTE: return 31;
+        case ITCH_EXECUTE_WITH_PRICE: return 36;
+        case ITCH_CANCEL: return 23;
+        case ITCH_DELETE: return 19;
+        case ITCH_REPLACE: return 35;
+    }
+    return 0;
+}
+
+static uint16_t
+readItch16(const uint8_t *field){
+    return (uint16_t)(field[0] << 8 | field[1]);
+}
+
+static uint32_t
+readItch32(const uint8_t *field){
+    return (uint32_t)field[0] << 24 | (uint32_t)field[1] << 16 | (uint32_t)field[2] << 8 | field[3];
+}
+
+static uint64_t
+readItch64(const uint8_t *field){
+    return (uint64_t)readItch32(field) << 32 | readItch32(field + 4);
+}
+
+static void
+writeItchField(uint8_t *field, uint64_t value, int bytes){
+    while(bytes-- > 0){
+        field[bytes] = (uint8_t)value;
+        value >>= 8;
+    }
+}
+
+static int
+releaseIfOut(Book *book, Order *order, int result){
+    /**
+     * Release the order to the pool if the operation took it out of the
+     * book, and pass on the operation's result.
+     */
+    if(order->parentLimit == NULL){
+        releaseOrder(book, order);
+    }
+    return result;
+}
+
+static int
+queueItchOrder(Book *book, const Instrument *instrument, Order *order, uint64_t reference,
+               uint32_t shares, uint32_t price){
+    order->id = reference;
+    order->shares = toQuantity(instrument, shares);
+    order->limit = toPrice(instrument, (double)price / ITCH_PRICE_SCALE);
+    return releaseIfOut(book, order, addOrder(book, order));
+}
+
+size_t
+encodeItchMessage(const ItchMessage *message, uint8_t *buffer){
+    /**
+     * Write the message with its length prefix to the buffer, which must
+     * hold ITCH_MAX_FRAME bytes. Returns the bytes written, or 0 if the
+     * type is not an order message. The tracking number and match numbers
+     * are written as 0, and the stock and attribution fields as blanks.
+     */
+    size_t length = getItchLength(message->type);
+    if(length == 0){
+        return 0;
+    }
+    uint8_t *body = buffer + 2;
+    memset(body, 0, length);
+    writeItchField(buffer, length, 2);
+    body[0] = message->type;
+    writeItchField(body + 1, message->stockLocate, 2);
+    writeItchField(body + 5, message->timestamp, 6);
+    writeItchField(body + 11, message->reference, 8);
+    switch(message->type){
+        case ITCH_ADD_ATTRIBUTED:
+            memset(body + 36, ' ', 4);
+            /* fall through */
+        case ITCH_ADD:
+            body[19] = message->side;
+            writeItchField(body + 20, message->shares, 4);
+            memset(body + 24, ' ', 8);
+            writeItchField(body + 32, message->price, 4);
+            break;
+        case ITCH_EXECUTE_WITH_PRICE:
+            body[31] = 'Y';
+            writeItchField(body + 32, message->price, 4);
+            /* fall through */
+        case ITCH_EXECUTE:
+        case ITCH_CANCEL:
+            writeItchField(body + 19, message->shares, 4);
+            break;
+        case ITCH_REPLACE:
+            writeItchField(body + 19, message->newReference, 8);
+            writeItchField(body + 27, message->shares, 4);
+            writeItchField(body + 31, message->price, 4);
+            break;
+    }
+    return length + 2;
+}
+
+int
+decodeItchMessage(BookRegistry *registry, const uint8_t *message, size_t length){
+    /**
+     * Apply one ITCH message, without its length prefix, to the book of its
+     * stock locate. Adds create the book of a lazy instrument.
+     *
+     * A cancel reduces the order in place, keeping its queue position; a
+     * replace moves the order to the back of the queue at its new price
+     * under its new reference. The price of an execution with price is
+     * the print's, not the order's, and does not change the book.
+     *
+     * Returns 1 on success and for skipped message types, the return code
+     * of the book operation if it failed, and 0 if the message is short or
+     * names an unknown instrument or order.
+     */
+    if(length == 0){
+        return 0;
+    }
+    char type = message[0];
+    size_t expected = getItchLength(type);
+    if(expected == 0){
+        return 1;
+    }
+    if(length < expected){
+        return 0;
+    }
+    uint16_t locate = readItch16(message + 1);
+    int isAdd = type == ITCH_ADD || type == ITCH_ADD_ATTRIBUTED;
+    Book *book = getInstrumentBook(registry, locate, isAdd);
+    if(book == NULL){
+        return 0;
+    }
+    const Instrument *instrument = &registry->entries[locate].instrument;
+    uint64_t reference = readItch64(message + 11);
+    Order *order;
+
+    if(isAdd){
+        order = allocateOrder(book);
+        if(order == NULL){
+            return 0;
+        }
+        order->buyOrSell = message[19] == 'B' ? BUY : message[19] == 'S' ? SELL : (unsigned)-1;
+        return queueItchOrder(book, instrument, order, reference, readItch32(message + 20), readItch32(message + 32));
+    }
+
+    order = getOrderById(book, reference);
+    if(order == NULL){
+        return 0;
+    }
+    switch(type){
+        case ITCH_EXECUTE:
+        case ITCH_EXECUTE_WITH_PRICE:
+            return releaseIfOut(book, order,
+                                executeOrderShares(book, order, toQuantity(instrument, readItch32(message + 19))));
+        case ITCH_CANCEL:{
+            Quantity cancelled = toQuantity(instrument, readItch32(message + 19));
+            if(cancelled < order->shares){
+                return modifyOrder(book, order, order->limit, order->shares - cancelled);
+            }
+            return releaseIfOut(book, order, cancelOrder(book, order));
+        }
+        case ITCH_DELETE:
+            return releaseIfOut(book, order, cancelOrder(book, order));
+        case ITCH_REPLACE:{
+            int result = cancelOrder(book, order);
+            if(result != 1){
+                return releaseIfOut(book, order, result);
+            }
+            return queueItchOrder(book, instrument, order, readItch64(message + 19),
+                                  readItch32(message + 27), readItch32(message + 31));
+        }
+    }
+    return 0;
+}
+
+size_t
+decodeItchBuffer(BookRegistry *registry, const uint8_t *buffer, size_t length, size_t *messages, size_t *failed){
+    /**
+     * Apply all complete length-prefixed messages in the buffer, adding
+     * their number to messages and the number of those decodeItchMessage()
+     * failed on to failed. Returns the bytes consumed; a message cut off
+     * at the end of the buffer is left for the next call.
+     */
+    size_t offset = 0;
+    while(offset + 2 <= length){
+        size_t size = readItch16(buffer + offset);
+        if(offset + 2 + size > length){
+            break;
+        }
+        if(decodeItchMessage(registry, buffer + offset + 2, size) != 1){
+            (*failed)++;
+        }
+        (*messages)++;
+        offset += 2 + size;
+    }
+    return offset;
+}
+
+int
+decodeItchFile(BookRegistry *registry, const char *path, size_t *messages, size_t *failed){
+    /**
+     * Map the ITCH file at the given path and apply all of its messages
+     * like decodeItchBuffer(). Returns 0 if the file cannot be mapped or
+     * ends in the middle of a message.
+     */
+    const void *data;
+    size_t size;
+    if(!mapInputFile(path, &data, &size)){
+        return 0;
+    }
+    size_t consumed = decodeItchBuffer(registry, data, size, messages, failed);
+    unmapInputFile(data, size);
+    return consumed == size;
+}
+
+int
+writeItchSample(const char *path, uint16_t stockLocate, size_t messages, unsigned seed){
+    /**
+     * Write a file of the given number of random but consistent order
+     * messages for one stock locate: every message refers to an order
+     * resting at that point, and executions and cancels never exceed its
+     * shares. Prices random walk around $100 in cent steps. The same seed
+     * gives the same file.
+     */
+    struct{
+        uint64_t reference;
+        char side;
+        uint32_t shares;
+    } *live = malloc(ITCH_SAMPLE_LIVE_ORDERS * sizeof(*live));
+    FILE *out = fopen(path, "wb");
+    if(live == NULL || out == NULL){
+        free(live);
+        if(out != NULL){
+            fclose(out);
+        }
+        return 0;
+    }
+
+    uint8_t frame[ITCH_MAX_FRAME];
+    ItchMessage message;
+    size_t liveCount = 0;
+    uint64_t nextReference = 1;
+    uint32_t mid = 100 * ITCH_PRICE_SCALE;
+    uint32_t tick = ITCH_PRICE_SCALE / 100;
+    size_t i;
+    int ok = 1;
+    memset(&message, 0, sizeof(message));
+    message.stockLocate = stockLocate;
+
+    for(i=0; i<messages && ok; i++){
+        message.timestamp = 34200000000000ULL + i * 1000;
+        unsigned roll = rand_r(&seed) % 100;
+        if(liveCount == 0 || (liveCount < ITCH_SAMPLE_LIVE_ORDERS && roll < 50)){
+            if(rand_r(&seed) % 2 == 0){
+                mid += tick;
+            }
+            else if(mid > 50 * tick){
+                mid -= tick;
+            }
+            message.type = roll % 10 == 0 ? ITCH_ADD_ATTRIBUTED : ITCH_ADD;
+            message.reference = nextReference++;
+            message.side = rand_r(&seed) % 2 ? 'B' : 'S';
+            message.shares = 100 * (1 + rand_r(&seed) % 10);
+            message.price = message.side == 'B' ? mid - tick * (rand_r(&seed) % 20)
+                                                : mid + tick * (1 + rand_r(&seed) % 20);
+            live[liveCount].reference = message.reference;
+            live[liveCount].side = message.side;
+            live[liveCount].shares = message.shares;
+            liveCount++;
+        }
+        else{
+            size_t slot = rand_r(&seed) % liveCount;
+            uint32_t shares = live[slot].shares;
+            message.reference = live[slot].reference;
+            message.shares = 1 + rand_r(&seed) % shares;
+            roll = rand_r(&seed) % 100;
+            if(roll < 25){
+                message.type = ITCH_EXECUTE;
+            }
+            else if(roll < 35){
+                message.type = ITCH_EXECUTE_WITH_PRICE;
+                message.price = mid;
+            }
+            else if(roll < 55 && shares > 1){
+                message.type = ITCH_CANCEL;
+                message.shares = 1 + rand_r(&seed) % (shares - 1);
+            }
+            else if(roll < 85){
+                message.type = ITCH_DELETE;
+                message.shares = shares;
+            }
+            else{
+                message.type = ITCH_REPLACE;
+                message.newReference = nextReference++;
+                message.shares = 100 * (1 + rand_r(&seed) % 10);
+                message.price = live[slot].side == 'B' ? mid - tick * (rand_r(&seed) % 20)
+                                                       : mid + tick * (1 + rand_r(&seed) % 20);
+                live[slot].reference = message.newReference;
+                live[slot].shares = message.shares;
+            }
+            if(message.type != ITCH_REPLACE){
+                live[slot].shares -= message.shares;
+            }
+            if(live[slot].shares == 0){
+                live[slot] = live[--liveCount];
+            }
+        }
+        size_t size = encodeItchMessage(&message, frame);
+        ok = fwrite(frame, size, 1, out) == 1;
+    }
+    free(live);
+    if(fclose(out) != 0){
+        ok = 0;
+    }
+    return ok;
+}
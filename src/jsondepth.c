@@ -0,0 +1,491 @@
+/**
+ * JSON Depth Operations
+ *
+ * Apply recorded JSON depth messages of crypto venues to an L2 book. A
+ * message's bids and asks are arrays of [price, size, ...] entries under
+ * the keys "b"/"a" or "bids"/"asks", at any depth of the message, which
+ * covers the usual diff and snapshot formats and their stream wrappers.
+ * Each entry sets the absolute size of a price level; a size of 0 removes
+ * the level.
+ *
+ * The parser walks the message in place, without building a tree or
+ * allocating, and converts decimal strings to integer ticks and lots
+ * digit by digit, without going through strtod. A message's level updates
+ * are collected first and applied to the book together, in chunks of
+ * DEPTH_FEED_MAX_UPDATES for large snapshots.
+ *
+ * The book holds one pooled order per level, so the feed must own it.
+ * Sequence numbers in the messages are not checked.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "hftlob.h"
+
+/* Nesting depth beyond which a message is rejected. */
+#define JSON_MAX_DEPTH 16
+
+typedef struct JsonCursor{
+    const char *at;
+    const char *end;
+} JsonCursor;
+
+
+static void
+skipJsonSpace(JsonCursor *cursor){
+    while(cursor->at < cursor->end
+          && (*cursor->at == ' ' || *cursor->at == '\t' || *cursor->at == '\n' || *cursor->at == '\r')){
+        cursor->at++;
+    }
+}
+
+static int
+expectJson(JsonCursor *cursor, char c){
+    /**
+     * Skip whitespace and the given character, or return 0 if the next
+     * character is a different one.
+     */
+    skipJsonSpace(cursor);
+    if(cursor->at == cursor->end || *cursor->at != c){
+        return 0;
+    }
+    cursor->at++;
+    return 1;
+}
+
+static int
+peekJson(JsonCursor *cursor, char c){
+    skipJsonSpace(cursor);
+    return cursor->at < cursor->end && *cursor->at == c;
+}
+
+static int
+parseJsonString(JsonCursor *cursor, const char **text, size_t *length){
+    /**
+     * Parse a string and point text at its raw contents, escapes and all.
+     */
+    if(!expectJson(cursor, '"')){
+        return 0;
+    }
+    *text = cursor->at;
+    while(cursor->at < cursor->end && *cursor->at != '"'){
+        if(*cursor->at == '\\'){
+            cursor->at++;
+        }
+        cursor->at++;
+    }
+    if(cursor->at >= cursor->end){
+        return 0;
+    }
+    *length = cursor->at - *text;
+    cursor->at++;
+    return 1;
+}
+
+static int
+parseJsonDecimal(JsonCursor *cursor, int decimals, int64_t *units){
+    /**
+     * Parse a non-negative decimal number, quoted or not, into units of
+     * 10^-decimals, rounding half up on further digits. Exponents are not
+     * accepted.
+     */
+    const char *text;
+    size_t length;
+    JsonCursor digits;
+    int quoted = peekJson(cursor, '"');
+    if(quoted){
+        if(!parseJsonString(cursor, &text, &length)){
+            return 0;
+        }
+        digits.at = text;
+        digits.end = text + length;
+    }
+    else{
+        digits.at = cursor->at;
+        digits.end = cursor->end;
+    }
+
+    int64_t value = 0;
+    int fraction = -1; /* digits after the point so far, -1 before it */
+    int seen = 0;
+    int roundUp = 0;
+    for(; digits.at < digits.end; digits.at++){
+        char c = *digits.at;
+        if(c == '.'){
+            if(fraction >= 0){
+                return 0;
+            }
+            fraction = 0;
+            continue;
+        }
+        if(c < '0' || c > '9'){
+            break;
+        }
+        seen++;
+        if(fraction < decimals){
+            if(value > (INT64_MAX - 9) / 10){
+                return 0;
+            }
+            value = value * 10 + (c - '0');
+            if(fraction >= 0){
+                fraction++;
+            }
+        }
+        else if(fraction == decimals){
+            roundUp = c >= '5';
+            fraction++;
+        }
+    }
+    if(seen == 0){
+        return 0;
+    }
+    for(fraction = fraction < 0 ? 0 : fraction; fraction < decimals; fraction++){
+        if(value > INT64_MAX / 10){
+            return 0;
+        }
+        value *= 10;
+    }
+    if(quoted && digits.at != digits.end){
+        return 0;
+    }
+    if(!quoted){
+        cursor->at = digits.at;
+    }
+    *units = value + roundUp;
+    return 1;
+}
+
+static int
+skipJsonValue(JsonCursor *cursor){
+    /**
+     * Skip a string, number or literal, or a whole object or array.
+     */
+    const char *text;
+    size_t length;
+    int depth = 0;
+    skipJsonSpace(cursor);
+    do{
+        if(cursor->at == cursor->end){
+            return 0;
+        }
+        char c = *cursor->at;
+        if(c == '"'){
+            if(!parseJsonString(cursor, &text, &length)){
+                return 0;
+            }
+            continue;
+        }
+        if(c == '{' || c == '['){
+            depth++;
+        }
+        else if(c == '}' || c == ']'){
+            if(depth == 0){
+                return 0;
+            }
+            depth--;
+        }
+        else if(depth == 0 && (c == ',' || c == ':')){
+            return 0;
+        }
+        cursor->at++;
+        if(depth == 0){
+            /* Numbers and literals end at the next delimiter. */
+            while(cursor->at < cursor->end && !strchr(",:]} \t\r\n", *cursor->at)){
+                cursor->at++;
+            }
+        }
+    } while(depth > 0);
+    return 1;
+}
+
+static Price
+tickPrice(const DepthFeed *feed, int64_t ticks){
+#ifdef HFTLOB_FIXED_POINT
+    (void)feed;
+    return ticks;
+#else
+    return ticks * feed->instrument.tickSize;
+#endif
+}
+
+static Quantity
+lotQuantity(const DepthFeed *feed, int64_t lots){
+#ifdef HFTLOB_FIXED_POINT
+    (void)feed;
+    return lots;
+#else
+    return lots * feed->instrument.lotSize;
+#endif
+}
+
+static void
+flushLevelUpdates(DepthFeed *feed){
+    feed->failed += applyLevelUpdates(feed->book, feed->updates, feed->updateCount);
+    feed->updateCount = 0;
+}
+
+static int
+parseJsonLevels(DepthFeed *feed, JsonCursor *cursor, unsigned buyOrSell){
+    /**
+     * Parse an array of [price, size, ...] entries into level updates.
+     */
+    int64_t ticks, lots;
+    if(!expectJson(cursor, '[')){
+        return 0;
+    }
+    if(expectJson(cursor, ']')){
+        return 1;
+    }
+    do{
+        if(!expectJson(cursor, '[')
+           || !parseJsonDecimal(cursor, feed->priceDecimals, &ticks)
+           || !expectJson(cursor, ',')
+           || !parseJsonDecimal(cursor, feed->sizeDecimals, &lots)){
+            return 0;
+        }
+        while(expectJson(cursor, ',')){
+            if(!skipJsonValue(cursor)){
+                return 0;
+            }
+        }
+        if(!expectJson(cursor, ']')){
+            return 0;
+        }
+        if(feed->updateCount == DEPTH_FEED_MAX_UPDATES){
+            flushLevelUpdates(feed);
+        }
+        LevelUpdate *update = &feed->updates[feed->updateCount++];
+        update->buyOrSell = buyOrSell;
+        update->price = tickPrice(feed, ticks);
+        update->size = lotQuantity(feed, lots);
+    } while(expectJson(cursor, ','));
+    return expectJson(cursor, ']');
+}
+
+static int
+getSideKey(const char *key, size_t length){
+    /**
+     * Return the side whose levels the given key holds, or -1.
+     */
+    if((length == 1 && key[0] == 'b') || (length == 4 && memcmp(key, "bids", 4) == 0)){
+        return BUY;
+    }
+    if((length == 1 && key[0] == 'a') || (length == 4 && memcmp(key, "asks", 4) == 0)){
+        return SELL;
+    }
+    return -1;
+}
+
+static int
+parseJsonValue(DepthFeed *feed, JsonCursor *cursor, int depth){
+    /**
+     * Parse a value, collecting the levels of all side keys in the objects
+     * within it and skipping everything else.
+     */
+    const char *key;
+    size_t length;
+    if(depth > JSON_MAX_DEPTH){
+        return 0;
+    }
+    if(expectJson(cursor, '{')){
+        if(expectJson(cursor, '}')){
+            return 1;
+        }
+        do{
+            if(!parseJsonString(cursor, &key, &length) || !expectJson(cursor, ':')){
+                return 0;
+            }
+            int side = getSideKey(key, length);
+            if(side >= 0 && peekJson(cursor, '[')){
+                if(!parseJsonLevels(feed, cursor, side)){
+                    return 0;
+                }
+            }
+            else if(!parseJsonValue(feed, cursor, depth + 1)){
+                return 0;
+            }
+        } while(expectJson(cursor, ','));
+        return expectJson(cursor, '}');
+    }
+    if(expectJson(cursor, '[')){
+        if(expectJson(cursor, ']')){
+            return 1;
+        }
+        do{
+            if(!parseJsonValue(feed, cursor, depth + 1)){
+                return 0;
+            }
+        } while(expectJson(cursor, ','));
+        return expectJson(cursor, ']');
+    }
+    return skipJsonValue(cursor);
+}
+
+int
+initDepthFeed(DepthFeed *feed, Book *book, int priceDecimals, int sizeDecimals){
+    /**
+     * Set up a feed for the given book, with prices in ticks of
+     * 10^-priceDecimals and sizes in lots of 10^-sizeDecimals. Returns 0
+     * if either number of decimals is outside 0 to 18.
+     */
+    double tickSize = 1, lotSize = 1;
+    int i;
+    if(priceDecimals < 0 || priceDecimals > 18 || sizeDecimals < 0 || sizeDecimals > 18){
+        return 0;
+    }
+    for(i=0; i<priceDecimals; i++){
+        tickSize *= 10;
+    }
+    for(i=0; i<sizeDecimals; i++){
+        lotSize *= 10;
+    }
+    feed->book = book;
+    initInstrument(&feed->instrument, 1 / tickSize, 1 / lotSize);
+    feed->priceDecimals = priceDecimals;
+    feed->sizeDecimals = sizeDecimals;
+    feed->updateCount = 0;
+    feed->failed = 0;
+    return 1;
+}
+
+size_t
+applyLevelUpdates(Book *book, const LevelUpdate *updates, size_t count){
+    /**
+     * Set the sizes of the given levels in an L2 book, which holds one
+     * order from allocateOrder() per level: a new level gets a new order,
+     * an existing one has its order resized, and a removed one has its
+     * orders cancelled and released. Removing a level which is not in the
+     * book is not an error.
+     *
+     * A level's order takes its handle as its id, so the levels of a book
+     * with an order id index do not collide; such a book cannot also hold
+     * orders added by id elsewhere, whose ids might match a handle.
+     *
+     * Returns the number of updates the book rejected.
+     */
+    size_t failed = 0;
+    size_t i;
+    for(i=0; i<count; i++){
+        const LevelUpdate *update = &updates[i];
+        Limit *limit = findBookLimit(book, update->buyOrSell, update->price);
+        if(update->size <= 0){
+            int remaining = limit != NULL ? limit->orderCount : 0;
+            while(remaining-- > 0){
+                Order *order = limit->headOrder;
+                cancelOrder(book, order);
+                releaseOrder(book, order);
+            }
+            continue;
+        }
+        if(limit != NULL){
+            if(modifyOrder(book, limit->headOrder, update->price, update->size) != 1){
+                failed++;
+            }
+            continue;
+        }
+        Order *order = allocateOrder(book);
+        if(order == NULL){
+            failed++;
+            continue;
+        }
+        order->id = getOrderHandle(book, order);
+        order->buyOrSell = update->buyOrSell;
+        order->limit = update->price;
+        order->shares = update->size;
+        if(addOrder(book, order) != 1){
+            releaseOrder(book, order);
+            failed++;
+        }
+    }
+    return failed;
+}
+
+int
+applyDepthMessage(DepthFeed *feed, const char *json, size_t length){
+    /**
+     * Parse one JSON depth message and apply its level updates to the
+     * feed's book.
+     *
+     * Returns 1 on success, -1 if the book rejected some of the updates,
+     * and 0 if the message is malformed. The updates of a malformed
+     * message are dropped, except for chunks of a large one which have
+     * already been applied.
+     */
+    JsonCursor cursor;
+    cursor.at = json;
+    cursor.end = json + length;
+    feed->updateCount = 0;
+    feed->failed = 0;
+    if(!peekJson(&cursor, '{') && !peekJson(&cursor, '[')){
+        return 0;
+    }
+    if(!parseJsonValue(feed, &cursor, 0)){
+        feed->updateCount = 0;
+        return 0;
+    }
+    skipJsonSpace(&cursor);
+    if(cursor.at != cursor.end){
+        feed->updateCount = 0;
+        return 0;
+    }
+    flushLevelUpdates(feed);
+    return feed->failed == 0 ? 1 : -1;
+}
+
+size_t
+applyDepthStream(DepthFeed *feed, const char *buffer, size_t length, size_t *messages, size_t *failed){
+    /**
+     * Apply all complete messages of a buffer of newline-delimited JSON
+     * messages, adding their number to messages and the number of those
+     * which did not apply cleanly to failed. Blank lines are skipped.
+     * Returns the bytes consumed; a message without its newline yet is
+     * left for the next call.
+     */
+    size_t offset = 0;
+    while(offset < length){
+        const char *line = buffer + offset;
+        const char *newline = memchr(line, '\n', length - offset);
+        if(newline == NULL){
+            break;
+        }
+        JsonCursor cursor;
+        cursor.at = line;
+        cursor.end = newline;
+        skipJsonSpace(&cursor);
+        if(cursor.at != cursor.end){
+            if(applyDepthMessage(feed, line, newline - line) != 1){
+                (*failed)++;
+            }
+            (*messages)++;
+        }
+        offset = newline + 1 - buffer;
+    }
+    return offset;
+}
+
+int
+applyDepthFile(DepthFeed *feed, const char *path, size_t *messages, size_t *failed){
+    /**
+     * Map the file of newline-delimited JSON messages at the given path
+     * and apply all of them like applyDepthStream(); the last message
+     * needs no newline. Returns 0 if the file cannot be mapped.
+     */
+    const void *data;
+    size_t size;
+    if(!mapInputFile(path, &data, &size)){
+        return 0;
+    }
+    size_t consumed = applyDepthStream(feed, data, size, messages, failed);
+    JsonCursor rest;
+    rest.at = (const char*)data + consumed;
+    rest.end = (const char*)data + size;
+    skipJsonSpace(&rest);
+    if(rest.at != rest.end){
+        if(applyDepthMessage(feed, (const char*)data + consumed, size - consumed) != 1){
+            (*failed)++;
+        }
+        (*messages)++;
+    }
+    unmapInputFile(data, size);
+    return 1;
+}
@@ -0,0 +1,369 @@
+/**
+ * Ladder Operations
+ *
+ * A ladder holds the limits of one side of the book whose prices fall in a
+ * window of consecutive ticks, in a contiguous ring of Limit slots. Finding
+ * or creating the limit for a price in the window is a single indexed load.
+ * Limits outside the window live in the side's limit tree; the book keeps
+ * the window around the inside, so the tree only holds the far levels.
+ *
+ * An occupancy bitmap over the slots finds the next non-empty limit in a
+ * few bit scans, however many empty ticks lie in between.
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "hftlob.h"
+
+
+int
+initLadder(Ladder *ladder, Price tickSize, size_t capacity){
+    /**
+     * Allocate a ladder for at least the given number of ticks.
+     */
+    size_t slots = 8;
+    size_t i;
+    while(slots < capacity){
+        slots *= 2;
+    }
+    ladder->slots = malloc(slots * sizeof(Limit));
+    if(ladder->slots == NULL){
+        return 0;
+    }
+    if(!initBitmap(&ladder->occupied, slots)){
+        free(ladder->slots);
+        ladder->slots = NULL;
+        return 0;
+    }
+    for(i=0; i<slots; i++){
+        initLimit(&ladder->slots[i]);
+    }
+    ladder->capacity = slots;
+    ladder->count = 0;
+    ladder->tickSize = tickSize;
+    ladder->baseTick = 0;
+    return 1;
+}
+
+void
+destroyLadder(Ladder *ladder){
+    size_t i;
+    for(i=0; i<ladder->capacity; i++){
+        destroyQueueIndex(&ladder->slots[i]);
+    }
+    free(ladder->slots);
+    destroyBitmap(&ladder->occupied);
+    ladder->slots = NULL;
+    ladder->capacity = 0;
+    ladder->count = 0;
+}
+
+int64_t
+getLadderTick(Ladder *ladder, Price price){
+    /**
+     * Return the tick index of the given price.
+     */
+#ifdef HFTLOB_FIXED_POINT
+    return price / ladder->tickSize;
+#else
+    return llround(price / ladder->tickSize);
+#endif
+}
+
+int
+snapToLadderGrid(Ladder *ladder, Price *price){
+    /**
+     * Check that the given price is a whole number of ticks, as every
+     * limit of a ladder book has to be. Doubles within a billionth of a
+     * tick of the grid are snapped onto it, so that prices which differ
+     * by rounding noise share one slot. Returns 0 for off-grid prices.
+     */
+#ifdef HFTLOB_FIXED_POINT
+    return *price % ladder->tickSize == 0;
+#else
+    if(!isfinite(*price)){
+        return 0;
+    }
+    Price snapped = getLadderTick(ladder, *price) * ladder->tickSize;
+    if(fabs(*price - snapped) > ladder->tickSize * 1e-9){
+        return 0;
+    }
+    *price = snapped;
+    return 1;
+#endif
+}
+
+Limit*
+getLadderLimit(Ladder *ladder, Price price){
+    /**
+     * Return the slot for the given price, or NULL if the price is outside
+     * the window. The slot holds a limit of the book only if it has orders.
+     */
+    int64_t tick = getLadderTick(ladder, price);
+    if(tick < ladder->baseTick || tick >= ladder->baseTick + (int64_t)ladder->capacity){
+        return NULL;
+    }
+    return &ladder->slots[tick & (ladder->capacity - 1)];
+}
+
+int
+ladderContains(Ladder *ladder, Limit *limit){
+    /**
+     * Check if the given limit is one of the ladder's slots.
+     */
+    if(limit >= ladder->slots && limit < ladder->slots + ladder->capacity){
+        return 1;
+    }
+    return 0;
+}
+
+void
+occupyLadderSlot(Ladder *ladder, Limit *slot, Price price){
+    /**
+     * Turn the given empty slot into the limit for the given price.
+     */
+    initLimit(slot);
+    slot->limitPrice = price;
+    setBitmapBit(&ladder->occupied, slot - ladder->slots);
+    ladder->count++;
+}
+
+void
+vacateLadderSlot(Ladder *ladder, Limit *slot){
+    /**
+     * Mark the given slot as empty; its orders must already be gone or
+     * moved elsewhere.
+     */
+    initLimit(slot);
+    clearBitmapBit(&ladder->occupied, slot - ladder->slots);
+    ladder->count--;
+}
+
+Limit*
+getNextLadderLimit(Ladder *ladder, Limit *limit, unsigned buyOrSell){
+    /**
+     * Return the next non-empty slot after the given one, away from the
+     * inside of the book (lower prices for buys, higher for sells), or
+     * NULL if there is none in the window.
+     *
+     * The ticks to search map to at most two runs of slots, as the window
+     * may wrap around the end of the ring.
+     */
+    int64_t tick = getLadderTick(ladder, limit->limitPrice);
+    int64_t mask = ladder->capacity - 1;
+    int64_t baseSlot = ladder->baseTick & mask;
+    int64_t slot;
+    if(buyOrSell == BUY){
+        if(tick - 1 < ladder->baseTick){
+            return NULL;
+        }
+        int64_t from = (tick - 1) & mask;
+        slot = findBitmapBitAtOrBelow(&ladder->occupied, from);
+        if(from < baseSlot && slot < 0){
+            slot = findBitmapBitAtOrBelow(&ladder->occupied, mask);
+        }
+        if(slot < 0 || (slot < baseSlot && (from >= baseSlot || slot > from))){
+            return NULL;
+        }
+    }
+    else{
+        if(tick + 1 >= ladder->baseTick + (int64_t)ladder->capacity){
+            return NULL;
+        }
+        int64_t from = (tick + 1) & mask;
+        int64_t lastSlot = (baseSlot - 1) & mask;
+        slot = findBitmapBitAtOrAbove(&ladder->occupied, from);
+        if(from > lastSlot && slot < 0){
+            slot = findBitmapBitAtOrAbove(&ladder->occupied, 0);
+        }
+        if(slot < 0 || (slot > lastSlot && (from <= lastSlot || slot < from))){
+            return NULL;
+        }
+    }
+    return &ladder->slots[slot];
+}
+
+static void
+getLadderTicksBetween(Ladder *ladder, Price low, Price high, int64_t *first, int64_t *last){
+    /**
+     * Write the first and last tick of the window with a price from low to
+     * high, inclusive; first is above last if there is none. The bounds are
+     * clamped to the window before they are turned into ticks, so that
+     * infinite or huge bounds do not overflow, and off-grid bounds only
+     * take in the ticks inside them.
+     */
+    Price windowLow = ladder->baseTick * ladder->tickSize;
+    Price windowHigh = (ladder->baseTick + (int64_t)ladder->capacity - 1) * ladder->tickSize;
+    if(low < windowLow){
+        low = windowLow;
+    }
+    if(high > windowHigh){
+        high = windowHigh;
+    }
+    if(!(low <= high)){
+        *first = 1;
+        *last = 0;
+        return;
+    }
+#ifdef HFTLOB_FIXED_POINT
+    *first = low / ladder->tickSize;
+    if(*first * ladder->tickSize < low){
+        (*first)++;
+    }
+    *last = high / ladder->tickSize;
+    if(*last * ladder->tickSize > high){
+        (*last)--;
+    }
+#else
+    /* Bounds within a billionth of a tick of the grid count as on it, as in snapToLadderGrid(). */
+    *first = (int64_t)ceil(low / ladder->tickSize - 1e-9);
+    *last = (int64_t)floor(high / ladder->tickSize + 1e-9);
+#endif
+}
+
+Quantity
+getLadderSizeBetween(Ladder *ladder, Price low, Price high, Volume *volume){
+    /**
+     * Return the total size of the ladder's limits with prices from low to
+     * high, inclusive, and write their total volume to volume if it is not
+     * NULL. Only the occupied slots in the range are visited.
+     */
+    int64_t mask = ladder->capacity - 1;
+    int64_t first, last;
+    int64_t runs[2][2];
+    int runCount = 0;
+    Quantity size = 0;
+    Volume totalVolume = 0;
+    int i;
+
+    getLadderTicksBetween(ladder, low, high, &first, &last);
+    if(first <= last){
+        /* The ticks map to one run of slots, or two if they wrap. */
+        runs[0][0] = first & mask;
+        runs[0][1] = last & mask;
+        runCount = 1;
+        if(runs[0][1] < runs[0][0]){
+            runs[1][0] = 0;
+            runs[1][1] = runs[0][1];
+            runs[0][1] = mask;
+            runCount = 2;
+        }
+    }
+    for(i=0; i<runCount; i++){
+        int64_t slot = findBitmapBitAtOrAbove(&ladder->occupied, runs[i][0]);
+        while(slot >= 0 && slot <= runs[i][1]){
+            size += ladder->slots[slot].size;
+            totalVolume += ladder->slots[slot].totalVolume;
+            slot = findBitmapBitAtOrAbove(&ladder->occupied, slot + 1);
+        }
+    }
+    if(volume != NULL){
+        *volume = totalVolume;
+    }
+    return size;
+}
+
+int
+moveLadderWindow(Ladder *ladder, Limit *tree, Pool *limitPool, unsigned buyOrSell, int64_t baseTick){
+    /**
+     * Move the ladder's window to start at the given tick.
+     *
+     * Limits leaving the window are moved into the given limit tree, in
+     * nodes from the given pool, and tree limits entering it are moved into
+     * their slots. This assumes the tree only holds limits further from the
+     * inside than the window, so entering limits are always found at the
+     * tree's inside end.
+     *
+     * Returns 0 and leaves the window where it is if the pool cannot supply
+     * a node for every leaving limit.
+     */
+    int64_t capacity = ladder->capacity;
+    int64_t oldBaseTick = ladder->baseTick;
+    int64_t first = 0;
+    int64_t last = 0;
+    int64_t tick;
+    Limit *slot;
+    Limit *limit;
+    Limit *nodes = NULL;
+
+    if(baseTick > oldBaseTick){
+        first = oldBaseTick;
+        last = baseTick < oldBaseTick + capacity ? baseTick : oldBaseTick + capacity;
+    }
+    else if(baseTick < oldBaseTick){
+        first = baseTick + capacity > oldBaseTick ? baseTick + capacity : oldBaseTick;
+        last = oldBaseTick + capacity;
+    }
+    /* Take all nodes up front, so that a dry pool fails before anything moved. */
+    for(tick=first; tick<last && ladder->count > 0; tick++){
+        if(ladder->slots[tick & (capacity - 1)].headOrder != NULL){
+            limit = allocFromPool(limitPool);
+            if(limit == NULL){
+                while(nodes != NULL){
+                    limit = nodes;
+                    nodes = nodes->parent;
+                    freeToPool(limitPool, limit);
+                }
+                return 0;
+            }
+            limit->parent = nodes;
+            nodes = limit;
+        }
+    }
+    for(tick=first; tick<last && ladder->count > 0; tick++){
+        slot = &ladder->slots[tick & (capacity - 1)];
+        if(slot->headOrder != NULL){
+            limit = nodes;
+            nodes = nodes->parent;
+            initLimit(limit);
+            copyLimit(slot, limit);
+            addNewLimit(tree, limit);
+            vacateLadderSlot(ladder, slot);
+        }
+    }
+    ladder->baseTick = baseTick;
+
+    while(tree->rightChild != NULL){
+        limit = buyOrSell == BUY ? getPredecessor(tree) : getSuccessor(tree);
+        slot = getLadderLimit(ladder, limit->limitPrice);
+        if(slot == NULL){
+            break;
+        }
+        occupyLadderSlot(ladder, slot, limit->limitPrice);
+        copyLimit(limit, slot);
+        removeLimit(limit);
+        freeToPool(limitPool, limit);
+    }
+    return 1;
+}
+
+int
+ladderCoversInside(Ladder *ladder, unsigned buyOrSell, Price price){
+    /**
+     * Check if the given inside price lies in the part of the window the
+     * ladder keeps the inside in.
+     *
+     * A side's limits sit at and behind its inside, so the window is placed
+     * with the inside a quarter of its ticks from the front edge, and is
+     * moved once the inside leaves it or drifts into its back quarter.
+     */
+    int64_t capacity = ladder->capacity;
+    int64_t offset = getLadderTick(ladder, price) - ladder->baseTick;
+    if(buyOrSell == BUY){
+        return offset >= capacity / 4 && offset < capacity;
+    }
+    return offset >= 0 && offset < capacity - capacity / 4;
+}
+
+int64_t
+getLadderBaseTick(Ladder *ladder, unsigned buyOrSell, Price price){
+    /**
+     * Return the base tick of the window which puts the given inside price
+     * a quarter of the window from its front edge.
+     */
+    int64_t capacity = ladder->capacity;
+    if(buyOrSell == BUY){
+        return getLadderTick(ladder, price) - (capacity - capacity / 4);
+    }
+    return getLadderTick(ladder, price) - capacity / 4;
+}
@@ -16,14 +16,49 @@ createRoot(void){
      */
     Limit *ptr_limit = malloc(sizeof(Limit));
     initLimit(ptr_limit);
-    ptr_limit->limitPrice = -INFINITY;
+    ptr_limit->limitPrice = MIN_PRICE;
+    ptr_limit->nextLimit = ptr_limit;
+    ptr_limit->prevLimit = ptr_limit;
     return ptr_limit;
 }
 
+Limit*
+createPooledRoot(Pool *pool){
+    /**
+     * Create a root like createRoot(), allocated from the given pool.
+     * Return NULL if the pool cannot grow.
+     */
+    Limit *ptr_limit = allocFromPool(pool);
+    if(ptr_limit == NULL){
+        return NULL;
+    }
+    initLimit(ptr_limit);
+    ptr_limit->limitPrice = MIN_PRICE;
+    ptr_limit->nextLimit = ptr_limit;
+    ptr_limit->prevLimit = ptr_limit;
+    return ptr_limit;
+}
+
+static void
+linkLimit(Limit *limit, Limit *prevLimit, Limit *nextLimit){
+    /**
+     * Thread a new limit into the in-order list between its neighbours.
+     */
+    limit->prevLimit = prevLimit;
+    limit->nextLimit = nextLimit;
+    /* Release: readers following the links see the limit initialised. */
+    if(prevLimit != NULL){
+        __atomic_store_n(&prevLimit->nextLimit, limit, __ATOMIC_RELEASE);
+    }
+    if(nextLimit != NULL){
+        __atomic_store_n(&nextLimit->prevLimit, limit, __ATOMIC_RELEASE);
+    }
+}
+
 int
 addNewLimit(Limit *root, Limit *limit){
     /**
-     * Add a new Limit struct to the given limit tree.
+     * Add a new Limit struct to the given limit tree and rebalance it.
      *
      * Asserts that the limit does not yet exist.
      * Also sets left and right child to NULL.
@@ -33,15 +68,19 @@ addNewLimit(Limit *root, Limit *limit){
     }
     limit->leftChild = NULL;
     limit->rightChild = NULL;
-
+    limit->height = 0;
+    limit->subtreeSize = limit->size;
+    limit->subtreeVolume = limit->totalVolume;
 
     Limit *currentLimit = root;
-    Limit *child;
     while(1){
         if(currentLimit->limitPrice < limit->limitPrice){
             if(currentLimit->rightChild == NULL){
                 currentLimit->rightChild = limit;
                 limit->parent = currentLimit;
+                linkLimit(limit, currentLimit, currentLimit->nextLimit);
+                adjustSubtreeTotals(currentLimit, limit->size, limit->totalVolume);
+                retraceBalance(currentLimit);
                 return 1;
             }
             else{
@@ -52,6 +91,9 @@ addNewLimit(Limit *root, Limit *limit){
             if(currentLimit->leftChild == NULL){
                 currentLimit->leftChild = limit;
                 limit->parent = currentLimit;
+                linkLimit(limit, currentLimit->prevLimit, currentLimit);
+                adjustSubtreeTotals(currentLimit, limit->size, limit->totalVolume);
+                retraceBalance(currentLimit);
                 return 1;
             }
             else{
@@ -92,54 +134,32 @@ replaceLimitInParent(Limit *limit, Limit *newLimit) {
     }
 }
 
-int
-removeLimit(Limit *limit){
+static void
+spliceOutLimit(Limit *limit){
     /**
-     * Remove the given limit from the tree it belongs to.
-     *
-     * This assumes it IS part of a limit tree.
+     * Take the given limit out of the tree's branches and rebalance it,
+     * leaving the in-order list untouched.
      *
      * Python Reference code here:
      *     https://en.wikipedia.org/wiki/Binary_search_tree#Deletion
      */
-    if(!hasGrandpa(limit) && limitIsRoot(limit)){
-        return 0;
-    }
-
     Limit *ptr_successor = limit;
     if(limit->leftChild != NULL && limit->rightChild != NULL){
-        /*Limit has two children*/
+        /*Limit has two children - swap the in-order successor into its place*/
         ptr_successor = getMinimumLimit(limit->rightChild);
-        Limit *parent = ptr_successor->parent;
-        Limit *leftChild = ptr_successor->rightChild;
-        Limit *rightChild = ptr_successor->leftChild;
-
-
-        if(limit->leftChild != ptr_successor){
-            ptr_successor->leftChild = limit->leftChild;
-        }
-        else{
-            ptr_successor->leftChild = NULL;
-        }
+        spliceOutLimit(ptr_successor);
 
-        if(limit->rightChild != ptr_successor){
-            ptr_successor->rightChild = limit->rightChild;
-        }
-        else{
-            ptr_successor->rightChild = NULL;
+        ptr_successor->leftChild = limit->leftChild;
+        ptr_successor->rightChild = limit->rightChild;
+        if(ptr_successor->leftChild != NULL){
+            ptr_successor->leftChild->parent = ptr_successor;
         }
-        limit->leftChild = leftChild;
-        limit->rightChild = rightChild;
-        ptr_successor->parent = limit->parent;
-        if(ptr_successor->parent->rightChild==limit){
-            ptr_successor->parent->rightChild = ptr_successor;
+        if(ptr_successor->rightChild != NULL){
+            ptr_successor->rightChild->parent = ptr_successor;
         }
-        else if(ptr_successor->parent->leftChild==limit){
-            ptr_successor->parent->leftChild = ptr_successor;
-        }
-        limit->parent = parent;
-
-        removeLimit(limit);
+        replaceLimitInParent(limit, ptr_successor);
+        updateHeight(ptr_successor);
+        retraceSubtreeTotals(ptr_successor);
     }
     else if(limit->leftChild != NULL && limit->rightChild == NULL){
         /*Limit has only left child*/
@@ -153,5 +173,101 @@ removeLimit(Limit *limit){
         /*Limit has no children*/
         replaceLimitInParent(limit, NULL);
     }
+    if(ptr_successor == limit){
+        retraceSubtreeTotals(limit->parent);
+    }
+    retraceBalance(limit->parent);
+}
+
+int
+removeLimit(Limit *limit){
+    /**
+     * Remove the given limit from the tree it belongs to and rebalance it.
+     *
+     * This assumes it IS part of a limit tree.
+     */
+    if(!hasGrandpa(limit) && limitIsRoot(limit)){
+        return 0;
+    }
+    /* The limit keeps its own links, for readers still standing on it. */
+    if(limit->prevLimit != NULL){
+        __atomic_store_n(&limit->prevLimit->nextLimit, limit->nextLimit, __ATOMIC_RELEASE);
+    }
+    if(limit->nextLimit != NULL){
+        __atomic_store_n(&limit->nextLimit->prevLimit, limit->prevLimit, __ATOMIC_RELEASE);
+    }
+    spliceOutLimit(limit);
     return 1;
-}
\ No newline at end of file
+}
+
+static void
+sumLimitsBelow(Limit *root, Price price, int inclusive, Quantity *size, Volume *volume){
+    /**
+     * Add the size and volume of all limits below (or at, if inclusive) the
+     * given price, descending once from the top of the tree.
+     */
+    Limit *limit = limitIsRoot(root) ? root->rightChild : root;
+    while(limit != NULL){
+        if(limit->limitPrice < price || (inclusive && limit->limitPrice == price)){
+            *size += limit->size;
+            *volume += limit->totalVolume;
+            if(limit->leftChild != NULL){
+                *size += limit->leftChild->subtreeSize;
+                *volume += limit->leftChild->subtreeVolume;
+            }
+            limit = limit->rightChild;
+        }
+        else{
+            limit = limit->leftChild;
+        }
+    }
+}
+
+Quantity
+getSizeBetween(Limit *root, Price low, Price high, Volume *volume){
+    /**
+     * Return the total size of the limits with prices from low to high,
+     * inclusive, in the given tree, and write their total volume to volume
+     * if it is not NULL. O(log M), using the subtree totals.
+     */
+    Quantity highSize = 0, lowSize = 0;
+    Volume highVolume = 0, lowVolume = 0;
+    if(low <= high){
+        sumLimitsBelow(root, high, 1, &highSize, &highVolume);
+        sumLimitsBelow(root, low, 0, &lowSize, &lowVolume);
+    }
+    if(volume != NULL){
+        *volume = highVolume - lowVolume;
+    }
+    return highSize - lowSize;
+}
+
+Quantity
+walkSizeBetween(Limit *root, Price low, Price high, Volume *volume){
+    /**
+     * Like getSizeBetween(), but without the subtree totals: find the
+     * lowest limit in range and follow the in-order links from there.
+     * O(log M + k) for k limits in range.
+     */
+    Quantity size = 0;
+    Volume totalVolume = 0;
+    Limit *first = NULL;
+    Limit *limit = limitIsRoot(root) ? root->rightChild : root;
+    while(limit != NULL){
+        if(limit->limitPrice >= low){
+            first = limit;
+            limit = limit->leftChild;
+        }
+        else{
+            limit = limit->rightChild;
+        }
+    }
+    for(limit=first; limit!=NULL && !limitIsRoot(limit) && limit->limitPrice<=high; limit=limit->nextLimit){
+        size += limit->size;
+        totalVolume += limit->totalVolume;
+    }
+    if(volume != NULL){
+        *volume = totalVolume;
+    }
+    return size;
+}
@@ -1,7 +1,110 @@
 #include <stdio.h>
 #include <string.h>
+#include <time.h>
 #include "hftlob.h"
 
+#define ITCH_SAMPLE_MESSAGES 1000000
+
+/* Books of ITCH stock locates, created by their first add. */
+static const BookTier ITCH_TIER = {4096, 1 << 16, 0, 1};
+
+int
+runReplay(const char *path){
+    /**
+     * Replay the recorded feed at the given path into a fresh book, with
+     * prices in cents and sizes in shares, and print its throughput and
+     * latency percentiles.
+     */
+    ReplayFile file;
+    ReplayStats stats;
+    Instrument instrument;
+    Book book;
+    if(!openReplayFile(&file, path)){
+        printf("Cannot open replay file %s\n", path);
+        return 1;
+    }
+    size_t adds = countReplayAdds(&file);
+    initInstrument(&instrument, 0.01, 1);
+    if(!initBook(&book) || !reserveOrders(&book, adds) || !reservePools(&book, 4096, adds, 0)
+       || !replayBook(&book, &instrument, &file, &stats)){
+        printf("Cannot set up a book for %zu orders\n", adds);
+        destroyBook(&book);
+        closeReplayFile(&file);
+        return 1;
+    }
+    printf("%zu messages (%zu failed) in %.3f ms: %.0f messages/sec\n",
+           stats.messages, stats.failed, stats.elapsedNs / 1e6,
+           stats.elapsedNs > 0 ? stats.messages * 1e9 / stats.elapsedNs : 0.0);
+    printf("latency ns: p50 %lld, p90 %lld, p99 %lld, p99.9 %lld, max %lld\n",
+           getReplayLatency(&stats, 50), getReplayLatency(&stats, 90), getReplayLatency(&stats, 99),
+           getReplayLatency(&stats, 99.9), stats.maxLatencyNs);
+    destroyBook(&book);
+    closeReplayFile(&file);
+    return 0;
+}
+
+int
+runItch(const char *path){
+    /**
+     * Decode the ITCH file at the given path into lazily created books for
+     * all stock locates, with prices in 1/10000 dollars and sizes in
+     * shares, and print its throughput.
+     */
+    BookRegistry registry;
+    struct timespec start, end;
+    size_t messages = 0, failed = 0;
+    uint32_t locate;
+    if(!initBookRegistry(&registry, 1 << 16)){
+        printf("Cannot allocate the book registry\n");
+        return 1;
+    }
+    for(locate=0; locate<registry.capacity; locate++){
+        registerInstrument(&registry, locate, 1.0 / ITCH_PRICE_SCALE, 1, &ITCH_TIER);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int ok = decodeItchFile(&registry, path, &messages, &failed);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if(!ok){
+        printf("Cannot decode ITCH file %s completely\n", path);
+    }
+    printf("%zu messages (%zu failed) into %u books in %.3f ms: %.0f messages/sec\n",
+           messages, failed, registry.bookCount, seconds * 1e3, seconds > 0 ? messages / seconds : 0.0);
+    destroyBookRegistry(&registry);
+    return ok ? 0 : 1;
+}
+
+int
+runJsonDepth(const char *path){
+    /**
+     * Apply the newline-delimited JSON depth messages at the given path to
+     * a fresh L2 book, with prices in cents and sizes in 10^-8 units, and
+     * print its throughput.
+     */
+    DepthFeed feed;
+    Book book;
+    struct timespec start, end;
+    size_t messages = 0, failed = 0;
+    if(!initBook(&book)){
+        printf("Cannot set up a book\n");
+        return 1;
+    }
+    initDepthFeed(&feed, &book, 2, 8);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    int ok = applyDepthFile(&feed, path, &messages, &failed);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if(!ok){
+        printf("Cannot open JSON depth file %s\n", path);
+    }
+    else{
+        printf("%zu messages (%zu failed) in %.3f ms: %.0f messages/sec\n",
+               messages, failed, seconds * 1e3, seconds > 0 ? messages / seconds : 0.0);
+    }
+    destroyBook(&book);
+    return ok ? 0 : 1;
+}
+
 int main(int argc, char* argv[]){
     int i;
     printf("Running main..\n");
@@ -10,6 +113,51 @@ int main(int argc, char* argv[]){
             printf("--test flag passed, running cuTest TestSuite..\n");
             RunAllTests();
         }
+        else if (strcmp(argv[i], "--bench") == 0){
+            printf("--bench flag passed, running benchmarks..\n");
+            RunAllBenchmarks();
+        }
+        else if (strcmp(argv[i], "--replay") == 0){
+            if(i + 1 >= argc){
+                printf("--replay needs a file\n");
+                return 1;
+            }
+            printf("--replay flag passed, replaying %s..\n", argv[i + 1]);
+            if(runReplay(argv[++i]) != 0){
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--itch") == 0){
+            if(i + 1 >= argc){
+                printf("--itch needs a file\n");
+                return 1;
+            }
+            printf("--itch flag passed, decoding %s..\n", argv[i + 1]);
+            if(runItch(argv[++i]) != 0){
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--json-depth") == 0){
+            if(i + 1 >= argc){
+                printf("--json-depth needs a file\n");
+                return 1;
+            }
+            printf("--json-depth flag passed, applying %s..\n", argv[i + 1]);
+            if(runJsonDepth(argv[++i]) != 0){
+                return 1;
+            }
+        }
+        else if (strcmp(argv[i], "--itch-sample") == 0){
+            if(i + 1 >= argc){
+                printf("--itch-sample needs a file\n");
+                return 1;
+            }
+            printf("--itch-sample flag passed, writing %d messages to %s..\n", ITCH_SAMPLE_MESSAGES, argv[i + 1]);
+            if(!writeItchSample(argv[++i], 1, ITCH_SAMPLE_MESSAGES, 1)){
+                printf("Cannot write %s\n", argv[i]);
+                return 1;
+            }
+        }
     }
 
     return 0;
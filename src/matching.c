@@ -0,0 +1,147 @@
+/**
+ * Matching Operations
+ *
+ * Match incoming orders against the opposite side of a Book in price-time
+ * priority: best price first, and at each price the oldest order first,
+ * which is the tail of the limit's queue. Every match is reported as a
+ * Fill in a buffer provided by the caller, so matching never allocates.
+ *
+ * Whether a fill-or-kill order can be filled is decided from the limits'
+ * aggregate sizes alone, without walking their order queues.
+ */
+
+#include <stdlib.h>
+#include "hftlob.h"
+
+
+static int
+crossesLimit(unsigned buyOrSell, Price price, Limit *limit){
+    /**
+     * Check if an order of the given side and limit price can trade at the
+     * given opposite limit.
+     */
+    if(limit == NULL){
+        return 0;
+    }
+    if(buyOrSell == BUY){
+        return price >= limit->limitPrice;
+    }
+    return price <= limit->limitPrice;
+}
+
+static size_t
+matchUpTo(Book *book, Order *order, Price price, Fill *fills, size_t maxFills){
+    /**
+     * Match the given order like matchOrder(), up to the given price.
+     */
+    unsigned makerSide = order->buyOrSell == BUY ? SELL : BUY;
+    Limit **inside = makerSide == BUY ? &book->highestBuy : &book->lowestSell;
+    size_t count = 0;
+
+    while(order->shares > 0 && count < maxFills && crossesLimit(order->buyOrSell, price, *inside)){
+        Limit *limit = *inside;
+        Order *maker = limit->tailOrder;
+        Fill *fill = &fills[count++];
+        fill->takerId = order->id;
+        fill->makerId = maker->id;
+        fill->maker = maker;
+        fill->price = limit->limitPrice;
+        if(order->shares < maker->shares){
+            fill->shares = order->shares;
+            fill->makerFilled = 0;
+            executeOrderShares(book, maker, order->shares);
+        }
+        else{
+            fill->shares = maker->shares;
+            fill->makerFilled = 1;
+            executeOrder(book, makerSide);
+        }
+        order->shares -= fill->shares;
+    }
+    return count;
+}
+
+size_t
+matchOrder(Book *book, Order *order, Fill *fills, size_t maxFills){
+    /**
+     * Match the given order against the opposite side of the book until it
+     * is filled, no longer crosses, or the fill buffer is full. Reduces
+     * order->shares by the amount filled and returns the number of fills.
+     *
+     * Resting orders that are filled completely are removed from the book,
+     * and emptied limits with them; partially filled ones keep their place.
+     */
+    return matchUpTo(book, order, order->limit, fills, maxFills);
+}
+
+Quantity
+getFillableShares(Book *book, unsigned buyOrSell, Price limit, Quantity shares, size_t *maxFillsNeeded){
+    /**
+     * Return how many of the given shares an order of the given side could
+     * fill up to the given limit price right now, and write an upper bound
+     * of the number of fills this takes to maxFillsNeeded.
+     *
+     * O(limits crossed): only the limits' sizes and order counts are read.
+     */
+    unsigned makerSide = buyOrSell == BUY ? SELL : BUY;
+    Limit *level = makerSide == BUY ? book->highestBuy : book->lowestSell;
+    Quantity fillable = 0;
+    *maxFillsNeeded = 0;
+    while(fillable < shares && crossesLimit(buyOrSell, limit, level)){
+        fillable += level->size;
+        *maxFillsNeeded += level->orderCount;
+        level = getNextBookLimit(book, level, makerSide);
+    }
+    return fillable < shares ? fillable : shares;
+}
+
+int
+submitOrder(Book *book, Order *order, int orderType, Fill *fills, size_t maxFills, size_t *fillCount){
+    /**
+     * Match the given order against the book according to its type, writing
+     * the fills to the given buffer and their number to fillCount. What is
+     * left of a limit order is added to the book; what is left of any other
+     * order stays in order->shares.
+     *
+     * Returns 1 on success, and 0 if the order's side or type is unknown, a
+     * fill-or-kill order cannot be filled completely, or the remainder of a
+     * limit order could not be added.
+     * Returns -1 if the fill buffer ran full while the order still crossed
+     * the book; the order then holds its remaining shares and is not in the
+     * book, and can be submitted again with a fresh buffer. A fill-or-kill
+     * order is rejected with -1 up front instead if the buffer might not
+     * hold all of its fills.
+     */
+    Price price = order->limit;
+    size_t maxFillsNeeded;
+    *fillCount = 0;
+    if(order->buyOrSell != BUY && order->buyOrSell != SELL){
+        return 0;
+    }
+    if(orderType != ORDER_LIMIT && orderType != ORDER_IOC && orderType != ORDER_FOK && orderType != ORDER_MARKET){
+        return 0;
+    }
+    if(orderType == ORDER_MARKET){
+        price = order->buyOrSell == BUY ? MAX_PRICE : MIN_PRICE;
+    }
+    else if(orderType == ORDER_FOK){
+        if(getFillableShares(book, order->buyOrSell, price, order->shares, &maxFillsNeeded) < order->shares){
+            return 0;
+        }
+        if(maxFillsNeeded > maxFills){
+            return -1;
+        }
+    }
+
+    *fillCount = matchUpTo(book, order, price, fills, maxFills);
+    if(order->shares <= 0){
+        return 1;
+    }
+    if(crossesLimit(order->buyOrSell, price, order->buyOrSell == BUY ? book->lowestSell : book->highestBuy)){
+        return -1;
+    }
+    if(orderType != ORDER_LIMIT){
+        return 1;
+    }
+    return addOrder(book, order);
+}
@@ -1,5 +1,13 @@
 /**
  * Order Operations
+ *
+ * A limit's orders can be indexed by arrival rank in a pair of Fenwick
+ * trees, which tell the shares and orders ahead of any order in O(log n).
+ * The index is only built for limits whose queue positions are asked for,
+ * and is freed when the limit runs out of orders.
+ *
+ * These functions keep a limit's own totals only; the subtree totals of
+ * the limits above it are left to the book, see enableRangeTotals().
  */
 
 #include <math.h>
@@ -8,6 +16,94 @@
 #include <stdlib.h>
 #include "hftlob.h"
 
+static void
+addToQueueIndex(QueueIndex *index, uint32_t rank, Quantity shares, int64_t orders){
+    for(; rank<=index->capacity; rank+=rank & -rank){
+        index->nodes[rank].shares += shares;
+        index->nodes[rank].orders += orders;
+    }
+}
+
+static int
+buildQueueIndex(Limit *limit){
+    /**
+     * (Re)build the limit's queue index, ranking its orders from the oldest
+     * at the tail, with room for at least as many orders again.
+     */
+    uint32_t capacity = 16;
+    uint32_t rank = 0;
+    uint32_t parent;
+    Order *order;
+    while(capacity < 2 * (uint32_t)limit->orderCount){
+        capacity *= 2;
+    }
+    QueueIndexNode *nodes = calloc(capacity + 1, sizeof(QueueIndexNode));
+    if(nodes == NULL){
+        destroyQueueIndex(limit);
+        return 0;
+    }
+    if(limit->queueIndex == NULL){
+        limit->queueIndex = malloc(sizeof(QueueIndex));
+        if(limit->queueIndex == NULL){
+            free(nodes);
+            return 0;
+        }
+    }
+    else{
+        free(limit->queueIndex->nodes);
+    }
+    for(order=limit->tailOrder; order!=NULL; order=order->prevOrder){
+        order->queueRank = ++rank;
+        nodes[rank].shares += order->shares;
+        nodes[rank].orders += 1;
+        /* Linear-time build: push each node's sum into its parent. */
+        parent = rank + (rank & -rank);
+        if(parent <= capacity){
+            nodes[parent].shares += nodes[rank].shares;
+            nodes[parent].orders += nodes[rank].orders;
+        }
+    }
+    /* Ranks past the last order hold nothing of their own. */
+    for(rank++; rank<=capacity; rank++){
+        parent = rank + (rank & -rank);
+        if(parent <= capacity){
+            nodes[parent].shares += nodes[rank].shares;
+            nodes[parent].orders += nodes[rank].orders;
+        }
+    }
+    limit->queueIndex->nodes = nodes;
+    limit->queueIndex->capacity = capacity;
+    limit->queueIndex->nextRank = limit->orderCount + 1;
+    return 1;
+}
+
+static void
+unindexOrder(Limit *limit, Order *order, Quantity shares, int64_t orders){
+    /**
+     * Take the given shares and orders off the order's rank, and free the
+     * index once the limit is empty.
+     */
+    if(limit->queueIndex == NULL){
+        return;
+    }
+    if(limit->orderCount == 0){
+        destroyQueueIndex(limit);
+        return;
+    }
+    addToQueueIndex(limit->queueIndex, order->queueRank, -shares, -orders);
+}
+
+static void
+storeLimitTotals(Limit *limit, int orderCount, Quantity size, Volume totalVolume){
+    /**
+     * Store the limit's totals with relaxed atomic stores, as readers in a
+     * read section load them while the book changes; see readLimitLevel().
+     */
+    __atomic_store_n(&limit->orderCount, orderCount, __ATOMIC_RELAXED);
+    __atomic_store(&limit->size, &size, __ATOMIC_RELAXED);
+    __atomic_store(&limit->totalVolume, &totalVolume, __ATOMIC_RELAXED);
+}
+
 int
 pushOrder(Limit *limit, Order *newOrder){
     /**
@@ -28,11 +124,21 @@ pushOrder(Limit *limit, Order *newOrder){
         limit->tailOrder = newOrder;
     };
 
-    limit->headOrder = newOrder;
-    limit->orderCount++;
-    limit->size += newOrder->shares;
-    limit->totalVolume += (newOrder->shares * limit->limitPrice);
+    /* Release: readers walking the queue see the order initialised. */
+    __atomic_store_n(&limit->headOrder, newOrder, __ATOMIC_RELEASE);
+    storeLimitTotals(limit, limit->orderCount + 1, limit->size + newOrder->shares,
+                     limit->totalVolume + newOrder->shares * limit->limitPrice);
 
+    if(limit->queueIndex != NULL){
+        if(limit->queueIndex->nextRank > limit->queueIndex->capacity){
+            /* Out of ranks; renumber the queue, which ranks this order too. */
+            buildQueueIndex(limit);
+        }
+        else{
+            newOrder->queueRank = limit->queueIndex->nextRank++;
+            addToQueueIndex(limit->queueIndex, newOrder->queueRank, newOrder->shares, 1);
+        }
+    }
     return 1;
 }
 
@@ -49,17 +155,16 @@ popOrder(Limit *limit){
 
     if (limit->tailOrder->prevOrder!= NULL){
         limit->tailOrder = limit->tailOrder->prevOrder;
-        limit->tailOrder->nextOrder = NULL;
-        limit->orderCount--;
-        limit->size -= ptr_poppedOrder->shares;
-        limit->totalVolume -= ptr_poppedOrder->shares * limit->limitPrice;
+        __atomic_store_n(&limit->tailOrder->nextOrder, NULL, __ATOMIC_RELEASE);
+        storeLimitTotals(limit, limit->orderCount - 1, limit->size - ptr_poppedOrder->shares,
+                         limit->totalVolume - ptr_poppedOrder->shares * limit->limitPrice);
+        unindexOrder(limit, ptr_poppedOrder, ptr_poppedOrder->shares, 1);
     }
     else{
-        limit->headOrder = NULL;
+        __atomic_store_n(&limit->headOrder, NULL, __ATOMIC_RELEASE);
         limit->tailOrder = NULL;
-        limit->orderCount = 0;
-        limit->size = 0;
-        limit->totalVolume = 0;
+        storeLimitTotals(limit, 0, 0, 0);
+        destroyQueueIndex(limit);
     }
 
     return ptr_poppedOrder;
@@ -72,27 +177,94 @@ removeOrder(Order *order){
      */
     if(order->parentLimit->headOrder == order && order->parentLimit->tailOrder == order){
         /* Head and Tail are identical, set both to NULL and be done with it.*/
-        order->parentLimit->headOrder = NULL;
+        __atomic_store_n(&order->parentLimit->headOrder, NULL, __ATOMIC_RELEASE);
         order->parentLimit->tailOrder = NULL;
     }
     else if(order->prevOrder != NULL && order->nextOrder != NULL){
         /* If Its in the middle, update reference for previous and next order and be done.*/
-        order->prevOrder->nextOrder = order->nextOrder;
+        __atomic_store_n(&order->prevOrder->nextOrder, order->nextOrder, __ATOMIC_RELEASE);
         order->nextOrder->prevOrder = order->prevOrder;
     }
     else if(order->nextOrder == NULL && order->parentLimit->tailOrder == order){
         /*This is the Tail - replace the tail with previous Order*/
-        order->prevOrder->nextOrder = NULL;
+        __atomic_store_n(&order->prevOrder->nextOrder, NULL, __ATOMIC_RELEASE);
         order->parentLimit->tailOrder = order->prevOrder;
     }
     else if(order->prevOrder == NULL && order->parentLimit->headOrder == order){
         /*This is the Head - replace the head with the next order*/
         order->nextOrder->prevOrder = NULL;
-        order->parentLimit->headOrder = order->nextOrder;
+        __atomic_store_n(&order->parentLimit->headOrder, order->nextOrder, __ATOMIC_RELEASE);
     }
     else{
         return -1;
     }
 
+    storeLimitTotals(order->parentLimit, order->parentLimit->orderCount - 1,
+                     order->parentLimit->size - order->shares,
+                     order->parentLimit->totalVolume - order->shares * order->parentLimit->limitPrice);
+    unindexOrder(order->parentLimit, order, order->shares, 1);
+    return 1;
+}
+
+int
+reduceOrder(Order *order, Quantity shares){
+    /**
+     * Reduce the order's shares in place, keeping its position in the queue.
+     *
+     * Fails if this would leave the order with no shares; remove it instead.
+     */
+    if(shares <= 0 || shares >= order->shares){
+        return 0;
+    }
+    Quantity remaining = order->shares - shares;
+    __atomic_store(&order->shares, &remaining, __ATOMIC_RELAXED);
+    if(order->parentLimit != NULL){
+        storeLimitTotals(order->parentLimit, order->parentLimit->orderCount,
+                         order->parentLimit->size - shares,
+                         order->parentLimit->totalVolume - shares * order->parentLimit->limitPrice);
+        unindexOrder(order->parentLimit, order, shares, 0);
+    }
+    return 1;
+}
+
+int
+getQueuePosition(Order *order, Quantity *sharesAhead, int *ordersAhead){
+    /**
+     * Write the shares and the number of orders ahead of the given order
+     * in its limit's queue, that is the older orders which would be filled
+     * before it. O(log n) in the limit's order count; the first query at a
+     * limit builds its index in O(n).
+     *
+     * Returns 0 if the order is not in a limit or the index could not be
+     * allocated.
+     */
+    Limit *limit = order->parentLimit;
+    if(limit == NULL){
+        return 0;
+    }
+    if(limit->queueIndex == NULL && !buildQueueIndex(limit)){
+        return 0;
+    }
+    Quantity shares = 0;
+    int64_t orders = 0;
+    uint32_t rank;
+    for(rank=order->queueRank - 1; rank>0; rank-=rank & -rank){
+        shares += limit->queueIndex->nodes[rank].shares;
+        orders += limit->queueIndex->nodes[rank].orders;
+    }
+    *sharesAhead = shares;
+    *ordersAhead = (int)orders;
     return 1;
+}
+
+void
+destroyQueueIndex(Limit *limit){
+    /**
+     * Free the limit's queue index, if it has one.
+     */
+    if(limit->queueIndex != NULL){
+        free(limit->queueIndex->nodes);
+        free(limit->queueIndex);
+        limit->queueIndex = NULL;
+    }
 }
\ No newline at end of file
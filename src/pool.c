@@ -0,0 +1,261 @@
+/**
+ * Pool Operations
+ *
+ * A pool hands out fixed-size objects from large slabs and recycles freed
+ * objects through an intrusive free list, so allocating and freeing are a
+ * couple of pointer moves. Slabs are only allocated when the pool is
+ * initialised or runs dry; preallocating enough capacity keeps malloc off
+ * the hot path entirely. All objects are released at once by destroyPool.
+ *
+ * Each slab is as large as all slabs before it, so a pool has O(log N)
+ * slabs, and every object has a fixed slot number which can index side
+ * tables kept next to the pool.
+ *
+ * Pools created with POOL_HANDLES also keep a 32 bit generation counter per
+ * slot, bumped whenever the object is freed, and hand out 64 bit handles
+ * made of slot and generation. Resolving a handle is a mask, a shift and
+ * one compare, and fails for handles to objects freed since. A slot has to
+ * be reused 2^32 times before a stale handle resolves again.
+ *
+ * Handles are for clients only; the links inside the book stay pointers.
+ */
+
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include "hftlob.h"
+
+#define POOL_DEFAULT_SLAB_OBJECTS 64
+#define POOL_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+#define POOL_CACHE_LINE_SIZE 64
+
+
+static size_t
+getSlabObjects(Pool *pool, size_t slab){
+    return slab == 0 ? pool->slabObjects : pool->slabObjects << (slab - 1);
+}
+
+static size_t
+getSlabBytes(Pool *pool, size_t slab){
+    size_t bytes = getSlabObjects(pool, slab) * pool->objectSize;
+    if(pool->flags & POOL_HUGE_PAGES){
+        bytes = (bytes + POOL_HUGE_PAGE_SIZE - 1) & ~(size_t)(POOL_HUGE_PAGE_SIZE - 1);
+    }
+    return bytes;
+}
+
+static int
+addSlab(Pool *pool){
+    /**
+     * Allocate a new slab and push all of its objects onto the free list,
+     * lowest address first.
+     */
+    size_t objects = getSlabObjects(pool, pool->slabCount);
+    size_t bytes = getSlabBytes(pool, pool->slabCount);
+    char *slab;
+    size_t i;
+
+    if(pool->slabCount == pool->slabCapacity){
+        size_t capacity = pool->slabCapacity > 0 ? pool->slabCapacity * 2 : 8;
+        void **slabs = realloc(pool->slabs, capacity * sizeof(void*));
+        if(slabs == NULL){
+            return 0;
+        }
+        pool->slabs = slabs;
+        pool->slabCapacity = capacity;
+    }
+
+    if(pool->flags & POOL_HANDLES){
+        size_t capacity = getPoolCapacity(pool) + objects;
+        if(capacity > POOL_HANDLE_MAX_SLOTS){
+            return 0;
+        }
+        uint32_t *generations = realloc(pool->generations, capacity * sizeof(uint32_t));
+        if(generations == NULL){
+            return 0;
+        }
+        memset(generations + capacity - objects, 0, objects * sizeof(uint32_t));
+        pool->generations = generations;
+    }
+
+    if(pool->flags & POOL_HUGE_PAGES){
+        /* Fall back to normal pages if no huge pages are reserved. */
+        slab = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if(slab == MAP_FAILED){
+            slab = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if(slab == MAP_FAILED){
+            return 0;
+        }
+    }
+    else{
+        if(posix_memalign((void**)&slab, POOL_CACHE_LINE_SIZE, bytes) != 0){
+            return 0;
+        }
+    }
+    pool->slabs[pool->slabCount++] = slab;
+
+    for(i=objects; i>0; i--){
+        void **object = (void**)(slab + (i - 1) * pool->objectSize);
+        *object = pool->freeList;
+        pool->freeList = object;
+    }
+    return 1;
+}
+
+int
+initPool(Pool *pool, size_t objectSize, size_t capacity, int flags){
+    /**
+     * Initialise a pool of objects of the given size. If capacity is not
+     * zero, a slab for at least that many objects is allocated right away;
+     * otherwise the first slab is allocated on the first allocation.
+     *
+     * With POOL_CACHE_ALIGNED, objects are padded to a multiple of the cache
+     * line size, so that an object no larger than a line sits in one line.
+     */
+    size_t slabObjects = POOL_DEFAULT_SLAB_OBJECTS;
+    while(slabObjects < capacity){
+        slabObjects *= 2;
+    }
+    if(objectSize < sizeof(void*)){
+        objectSize = sizeof(void*);
+    }
+    size_t alignment = flags & POOL_CACHE_ALIGNED ? POOL_CACHE_LINE_SIZE : sizeof(void*);
+    pool->freeList = NULL;
+    pool->objectSize = (objectSize + alignment - 1) & ~(alignment - 1);
+    pool->slabObjects = slabObjects;
+    pool->slabs = NULL;
+    pool->slabCount = 0;
+    pool->slabCapacity = 0;
+    pool->count = 0;
+    pool->flags = flags;
+    pool->generations = NULL;
+    if(capacity > 0 && !addSlab(pool)){
+        destroyPool(pool);
+        return 0;
+    }
+    return 1;
+}
+
+void
+destroyPool(Pool *pool){
+    /**
+     * Free all slabs of the pool, and with them every object allocated
+     * from it.
+     */
+    size_t i;
+    for(i=0; i<pool->slabCount; i++){
+        if(pool->flags & POOL_HUGE_PAGES){
+            munmap(pool->slabs[i], getSlabBytes(pool, i));
+        }
+        else{
+            free(pool->slabs[i]);
+        }
+    }
+    free(pool->slabs);
+    free(pool->generations);
+    pool->generations = NULL;
+    pool->slabs = NULL;
+    pool->slabCount = 0;
+    pool->slabCapacity = 0;
+    pool->freeList = NULL;
+    pool->count = 0;
+}
+
+void*
+allocFromPool(Pool *pool){
+    /**
+     * Return an uninitialised object, or NULL if the pool is dry and a
+     * new slab cannot be allocated.
+     */
+    void **object = pool->freeList;
+    if(object == NULL){
+        if(!addSlab(pool)){
+            return NULL;
+        }
+        object = pool->freeList;
+    }
+    pool->freeList = *object;
+    pool->count++;
+    return object;
+}
+
+void
+freeToPool(Pool *pool, void *object){
+    if(pool->generations != NULL){
+        pool->generations[getPoolSlot(pool, object)]++;
+    }
+    *(void**)object = pool->freeList;
+    pool->freeList = object;
+    pool->count--;
+}
+
+size_t
+getPoolCapacity(Pool *pool){
+    /**
+     * Return the number of objects the pool holds without growing.
+     */
+    return pool->slabCount == 0 ? 0 : pool->slabObjects << (pool->slabCount - 1);
+}
+
+size_t
+getPoolSlot(Pool *pool, const void *object){
+    /**
+     * Return the slot number of an object of the pool, which is less than
+     * getPoolCapacity(), or (size_t)-1 if the object is not from the pool.
+     * O(number of slabs).
+     */
+    const char *ptr = object;
+    size_t slab;
+    for(slab=0; slab<pool->slabCount; slab++){
+        const char *start = pool->slabs[slab];
+        size_t objects = getSlabObjects(pool, slab);
+        if(ptr >= start && ptr < start + objects * pool->objectSize){
+            size_t base = slab == 0 ? 0 : objects;
+            return base + (ptr - start) / pool->objectSize;
+        }
+    }
+    return (size_t)-1;
+}
+
+void*
+getPoolObject(Pool *pool, size_t slot){
+    /**
+     * Return the object in the given slot, which must be less than
+     * getPoolCapacity().
+     */
+    size_t slab = 0;
+    size_t base = 0;
+    if(slot >= pool->slabObjects){
+        slab = 64 - __builtin_clzll(slot / pool->slabObjects);
+        base = getSlabObjects(pool, slab);
+    }
+    return (char*)pool->slabs[slab] + (slot - base) * pool->objectSize;
+}
+
+uint64_t
+getPoolHandle(Pool *pool, const void *object){
+    /**
+     * Return the handle of an allocated object of a POOL_HANDLES pool.
+     */
+    size_t slot = getPoolSlot(pool, object);
+    return (uint64_t)slot | (uint64_t)pool->generations[slot] << POOL_HANDLE_SLOT_BITS;
+}
+
+void*
+getPoolObjectByHandle(Pool *pool, uint64_t handle){
+    /**
+     * Return the object of the given handle, or NULL if the handle is not
+     * from this pool or its object has been freed since. Generations wrap
+     * around only after 2^32 reuses of a slot.
+     */
+    size_t slot = handle & (POOL_HANDLE_MAX_SLOTS - 1);
+    if(pool->generations == NULL || slot >= getPoolCapacity(pool)
+       || pool->generations[slot] != handle >> POOL_HANDLE_SLOT_BITS){
+        return NULL;
+    }
+    return getPoolObject(pool, slot);
+}
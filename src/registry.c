@@ -0,0 +1,157 @@
+/**
+ * Registry Operations
+ *
+ * A registry holds the books of many instruments in one array indexed by
+ * compact instrument id, so routing an event to its book is one indexed
+ * load. Each instrument has its own tick and lot sizes and a tier, which
+ * sizes its book's pools, order id index and ladders.
+ *
+ * Books of lazy tiers are only created when their instrument sees its
+ * first order, so a registry of mostly idle instruments costs little more
+ * than one entry per instrument.
+ */
+
+#include <stdlib.h>
+#include "hftlob.h"
+
+
+const BookTier LIQUID_TIER = {4096, 1 << 16, 4096, 0};
+const BookTier ACTIVE_TIER = {512, 1 << 12, 512, 0};
+const BookTier ILLIQUID_TIER = {0, 1 << 8, 0, 1};
+
+
+static Book*
+createTierBook(const Instrument *instrument, const BookTier *tier){
+    /**
+     * Allocate a book set up as the given tier asks. The pools of a lazy
+     * tier's book are not reserved, so an idle book holds little more than
+     * its order id index and first limit slab.
+     */
+    Book *book = malloc(sizeof(Book));
+    if(book == NULL){
+        return NULL;
+    }
+    if(!initBook(book)){
+        free(book);
+        return NULL;
+    }
+    if((!tier->lazy && !reservePools(book, tier->expectedLimits, tier->expectedOrders, 0))
+       || (tier->expectedOrders > 0 && !reserveOrders(book, tier->expectedOrders))
+       || (tier->ladderTicks > 0
+           && !initLadders(book, toPrice(instrument, instrument->tickSize), tier->ladderTicks))){
+        destroyBook(book);
+        free(book);
+        return NULL;
+    }
+    return book;
+}
+
+int
+initBookRegistry(BookRegistry *registry, uint32_t capacity){
+    /**
+     * Initialise a registry for instrument ids below the given capacity.
+     */
+    registry->entries = calloc(capacity, sizeof(RegistryEntry));
+    if(registry->entries == NULL){
+        return 0;
+    }
+    registry->capacity = capacity;
+    registry->bookCount = 0;
+    return 1;
+}
+
+void
+destroyBookRegistry(BookRegistry *registry){
+    /**
+     * Destroy and free the books of all instruments.
+     */
+    uint32_t id;
+    for(id=0; id<registry->capacity; id++){
+        if(registry->entries[id].book != NULL){
+            destroyBook(registry->entries[id].book);
+            free(registry->entries[id].book);
+        }
+    }
+    free(registry->entries);
+    registry->entries = NULL;
+    registry->capacity = 0;
+    registry->bookCount = 0;
+}
+
+int
+registerInstrument(BookRegistry *registry, uint32_t id, double tickSize, double lotSize, const BookTier *tier){
+    /**
+     * Register an instrument under the given id with its tick and lot size
+     * and tier. The book is created right away unless the tier is lazy.
+     * A NULL tier registers the instrument as ILLIQUID_TIER.
+     *
+     * Returns 0 if the id is out of range or taken, or the book could not
+     * be allocated.
+     */
+    if(id >= registry->capacity || registry->entries[id].tier != NULL){
+        return 0;
+    }
+    if(tier == NULL){
+        tier = &ILLIQUID_TIER;
+    }
+    RegistryEntry *entry = &registry->entries[id];
+    initInstrument(&entry->instrument, tickSize, lotSize);
+    entry->tier = tier;
+    entry->book = NULL;
+    if(!tier->lazy && getInstrumentBook(registry, id, 1) == NULL){
+        entry->tier = NULL;
+        return 0;
+    }
+    return 1;
+}
+
+Book*
+getInstrumentBook(BookRegistry *registry, uint32_t id, int create){
+    /**
+     * Return the book of the instrument with the given id, or NULL if it
+     * is not registered. A book of a lazy tier that does not exist yet is
+     * created if create is set, and NULL returned otherwise.
+     */
+    if(id >= registry->capacity || registry->entries[id].tier == NULL){
+        return NULL;
+    }
+    RegistryEntry *entry = &registry->entries[id];
+    if(entry->book == NULL && create){
+        entry->book = createTierBook(&entry->instrument, entry->tier);
+        if(entry->book != NULL){
+            registry->bookCount++;
+        }
+    }
+    return entry->book;
+}
+
+size_t
+dispatchEvents(BookRegistry *registry, Event *events, size_t count){
+    /**
+     * Apply each event to the book of its instrument, like applyEvents().
+     * Consecutive events of the same instrument go to the book as one
+     * batch. Events of unregistered instruments fail with result 0, as do
+     * events other than adds for instruments without a book yet.
+     *
+     * Returns the number of events which failed.
+     */
+    size_t failed = 0;
+    size_t i = 0;
+    while(i < count){
+        size_t run = 1;
+        while(i + run < count && events[i + run].instrument == events[i].instrument){
+            run++;
+        }
+        Book *book = getInstrumentBook(registry, events[i].instrument, events[i].type == EVENT_ADD);
+        if(book == NULL){
+            /* Without a book, only an add could start a new run. */
+            events[i].result = 0;
+            failed++;
+            i++;
+            continue;
+        }
+        failed += applyEvents(book, &events[i], run, NULL);
+        i += run;
+    }
+    return failed;
+}
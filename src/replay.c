@@ -0,0 +1,295 @@
+/**
+ * Replay Operations
+ *
+ * Replay a recorded feed from a file of fixed-size ReplayRecords against a
+ * Book, offline and as fast as the book goes. The file is mapped read-only
+ * and its records are decoded where they lie, so replaying never copies
+ * or allocates per message: adds take their orders from the book's order
+ * pool, and all other messages find their order in the book's order id
+ * index.
+ *
+ * Each message is timed on its own, and the latencies are kept in a
+ * log-linear histogram with 16 buckets per power of two, so percentiles
+ * are exact to within 1/16th without storing every sample.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "hftlob.h"
+
+
+static long long
+replayNow(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static size_t
+getLatencyBucket(long long latency){
+    unsigned long long ns = latency > 0 ? (unsigned long long)latency : 0;
+    if(ns < REPLAY_LATENCY_SUB_BUCKETS){
+        return ns;
+    }
+    int shift = 63 - __builtin_clzll(ns) - 4;
+    return (shift + 1) * REPLAY_LATENCY_SUB_BUCKETS + ((ns >> shift) & (REPLAY_LATENCY_SUB_BUCKETS - 1));
+}
+
+static long long
+getLatencyBucketBound(size_t bucket){
+    /**
+     * Return the highest latency which falls into the given bucket.
+     */
+    if(bucket < REPLAY_LATENCY_SUB_BUCKETS){
+        return bucket;
+    }
+    int shift = bucket / REPLAY_LATENCY_SUB_BUCKETS - 1;
+    long long low = (long long)(REPLAY_LATENCY_SUB_BUCKETS + bucket % REPLAY_LATENCY_SUB_BUCKETS) << shift;
+    return low + (1LL << shift) - 1;
+}
+
+static Price
+recordPrice(const Instrument *instrument, int64_t ticks){
+#ifdef HFTLOB_FIXED_POINT
+    (void)instrument;
+    return ticks;
+#else
+    return ticks * instrument->tickSize;
+#endif
+}
+
+static Quantity
+recordShares(const Instrument *instrument, int64_t lots){
+#ifdef HFTLOB_FIXED_POINT
+    (void)instrument;
+    return lots;
+#else
+    return lots * instrument->lotSize;
+#endif
+}
+
+int
+mapInputFile(const char *path, const void **data, size_t *size){
+    /**
+     * Map the file at the given path read-only, writing its address and
+     * size to data and size; an empty file maps to NULL. Returns 0 if the
+     * file cannot be mapped.
+     *
+     * The mapping is populated up front, so that page faults do not show
+     * up in the latencies of whatever reads it.
+     */
+    struct stat st;
+    int fd = open(path, O_RDONLY);
+    *data = NULL;
+    *size = 0;
+    if(fd < 0){
+        return 0;
+    }
+    if(fstat(fd, &st) != 0){
+        close(fd);
+        return 0;
+    }
+    if(st.st_size == 0){
+        close(fd);
+        return 1;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        return 0;
+    }
+    madvise(map, st.st_size, MADV_SEQUENTIAL);
+    *data = map;
+    *size = st.st_size;
+    return 1;
+}
+
+void
+unmapInputFile(const void *data, size_t size){
+    if(data != NULL){
+        munmap((void*)data, size);
+    }
+}
+
+int
+openReplayFile(ReplayFile *file, const char *path){
+    /**
+     * Map the replay file at the given path. Returns 0 if it cannot be
+     * mapped, or is not a replay file of this build's record layout.
+     */
+    file->records = NULL;
+    file->count = 0;
+    if(!mapInputFile(path, &file->map, &file->mapSize)){
+        return 0;
+    }
+    const ReplayHeader *header = file->map;
+    if(file->mapSize < sizeof(ReplayHeader)
+       || memcmp(header->magic, REPLAY_MAGIC, sizeof(header->magic)) != 0
+       || header->recordSize != sizeof(ReplayRecord)
+       || header->recordCount > (file->mapSize - sizeof(ReplayHeader)) / sizeof(ReplayRecord)){
+        closeReplayFile(file);
+        return 0;
+    }
+    file->records = (const ReplayRecord*)(header + 1);
+    file->count = header->recordCount;
+    return 1;
+}
+
+void
+closeReplayFile(ReplayFile *file){
+    unmapInputFile(file->map, file->mapSize);
+    file->map = NULL;
+    file->mapSize = 0;
+    file->records = NULL;
+    file->count = 0;
+}
+
+int
+writeReplayFile(const char *path, const ReplayRecord *records, size_t count){
+    /**
+     * Write the given records to a new replay file at the given path.
+     */
+    ReplayHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    header.recordSize = sizeof(ReplayRecord);
+    header.recordCount = count;
+
+    FILE *out = fopen(path, "wb");
+    if(out == NULL){
+        return 0;
+    }
+    int ok = fwrite(&header, sizeof(header), 1, out) == 1
+             && fwrite(records, sizeof(ReplayRecord), count, out) == count;
+    if(fclose(out) != 0){
+        ok = 0;
+    }
+    return ok;
+}
+
+int
+applyReplayRecord(Book *book, const Instrument *instrument, const ReplayRecord *record){
+    /**
+     * Apply one record to the book, which needs an order id index. Adds
+     * take an order from allocateOrder(), and the order is released again
+     * once it leaves the book. Returns the return code of the book
+     * operation, or 0 if the record names no order in the book.
+     */
+    Order *order;
+    int result;
+    if(record->type == EVENT_ADD){
+        order = allocateOrder(book);
+        if(order == NULL){
+            return 0;
+        }
+        order->id = record->id;
+        order->buyOrSell = record->buyOrSell;
+        order->limit = recordPrice(instrument, record->price);
+        order->shares = recordShares(instrument, record->shares);
+        result = addOrder(book, order);
+        if(result != 1){
+            releaseOrder(book, order);
+        }
+        return result;
+    }
+
+    order = getOrderById(book, record->id);
+    if(order == NULL){
+        return 0;
+    }
+    switch(record->type){
+        case EVENT_CANCEL:
+            result = cancelOrder(book, order);
+            break;
+        case EVENT_MODIFY:
+            result = modifyOrder(book, order, recordPrice(instrument, record->price),
+                                 recordShares(instrument, record->shares));
+            break;
+        case EVENT_EXECUTE:
+            result = executeOrderShares(book, order, recordShares(instrument, record->shares));
+            break;
+        default:
+            return 0;
+    }
+    if(order->parentLimit == NULL){
+        releaseOrder(book, order);
+    }
+    return result;
+}
+
+size_t
+countReplayAdds(const ReplayFile *file){
+    /**
+     * Return the number of adds in the file, which bounds the number of
+     * orders resting at once; use it to size the book before a replay.
+     */
+    size_t adds = 0;
+    size_t i;
+    for(i=0; i<file->count; i++){
+        adds += file->records[i].type == EVENT_ADD;
+    }
+    return adds;
+}
+
+int
+replayBook(Book *book, const Instrument *instrument, const ReplayFile *file, ReplayStats *stats){
+    /**
+     * Apply all records of the file to the book in order, timing each
+     * message. Returns 0 if the book has no order id index.
+     *
+     * A message's latency runs from the end of the previous message to the
+     * end of its own, so that each takes a single clock read.
+     */
+    size_t i;
+    memset(stats, 0, sizeof(*stats));
+    if(book->orders.slots == NULL){
+        return 0;
+    }
+    long long start = replayNow();
+    long long last = start;
+    for(i=0; i<file->count; i++){
+        if(applyReplayRecord(book, instrument, &file->records[i]) != 1){
+            stats->failed++;
+        }
+        long long now = replayNow();
+        long long latency = now - last;
+        stats->latencies[getLatencyBucket(latency)]++;
+        if(latency > stats->maxLatencyNs){
+            stats->maxLatencyNs = latency;
+        }
+        last = now;
+    }
+    stats->messages = file->count;
+    stats->elapsedNs = last - start;
+    return 1;
+}
+
+long long
+getReplayLatency(const ReplayStats *stats, double percentile){
+    /**
+     * Return the given percentile (0 to 100) of the replay's per-message
+     * latencies in nanoseconds, rounded up to the end of its histogram
+     * bucket but never above the largest latency seen.
+     */
+    uint64_t rank = (uint64_t)ceil(percentile / 100.0 * stats->messages);
+    uint64_t seen = 0;
+    size_t bucket;
+    if(rank == 0){
+        rank = 1;
+    }
+    for(bucket=0; bucket<REPLAY_LATENCY_BUCKETS; bucket++){
+        seen += stats->latencies[bucket];
+        if(seen >= rank){
+            long long bound = getLatencyBucketBound(bucket);
+            return bound < stats->maxLatencyNs ? bound : stats->maxLatencyNs;
+        }
+    }
+    return stats->maxLatencyNs;
+}
@@ -0,0 +1,145 @@
+/**
+ * Snapshot Operations
+ *
+ * A book can publish the inside and the best few levels of both sides to
+ * a BookSnapshot, for threads other than the one changing the book. The
+ * snapshot is a seqlock: the writer makes the sequence odd, stores the
+ * data and makes it even again, and readers retry if the sequence was odd
+ * or changed while they copied. The writer never waits for readers, and a
+ * reader only retries if it overlapped a publication.
+ *
+ * The data is stored as relaxed atomic words, so that concurrent copies
+ * are well defined. The writer keeps a private copy of what it published
+ * and skips changes behind the published levels.
+ */
+
+#include <string.h>
+#include "hftlob.h"
+
+
+static int
+priceIsBehind(unsigned buyOrSell, Price price, Price other){
+    if(buyOrSell == BUY){
+        return price < other;
+    }
+    return price > other;
+}
+
+static int
+collectLevels(Book *book, unsigned buyOrSell, DepthLevel *levels){
+    /**
+     * Write the best SNAPSHOT_LEVELS levels of the given side to levels,
+     * and return how many there are.
+     */
+    Limit *limit = buyOrSell == BUY ? book->highestBuy : book->lowestSell;
+    int count = 0;
+    while(limit != NULL && count < SNAPSHOT_LEVELS){
+        levels[count].price = limit->limitPrice;
+        levels[count].size = limit->size;
+        levels[count].orders = limit->orderCount;
+        count++;
+        limit = getNextBookLimit(book, limit, buyOrSell);
+    }
+    return count;
+}
+
+void
+initBookSnapshot(BookSnapshot *snapshot){
+    atomic_init(&snapshot->sequence, 0);
+    memset(&snapshot->published, 0, sizeof(BookSnapshotData));
+    size_t i;
+    for(i=0; i<SNAPSHOT_WORDS; i++){
+        atomic_init(&snapshot->words[i], 0);
+    }
+}
+
+void
+attachBookSnapshot(Book *book, BookSnapshot *snapshot){
+    /**
+     * Publish the book's inside to the given snapshot from now on, after
+     * every change of the published levels, starting right away. NULL
+     * stops publishing.
+     */
+    book->snapshot = snapshot;
+    if(snapshot != NULL){
+        publishBookSnapshot(book);
+    }
+}
+
+void
+publishBookSnapshot(Book *book){
+    /**
+     * Publish the current inside of the book to its snapshot.
+     */
+    BookSnapshot *snapshot = book->snapshot;
+    BookSnapshotData *data = &snapshot->published;
+    uint64_t words[SNAPSHOT_WORDS];
+    unsigned sequence;
+    size_t i;
+
+    memset(words, 0, sizeof(words));
+    memset(data, 0, sizeof(BookSnapshotData));
+    getTopOfBook(book, &data->top);
+    data->bidLevels = collectLevels(book, BUY, data->bids);
+    data->askLevels = collectLevels(book, SELL, data->asks);
+    memcpy(words, data, sizeof(BookSnapshotData));
+
+    sequence = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    atomic_store_explicit(&snapshot->sequence, sequence + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    for(i=0; i<SNAPSHOT_WORDS; i++){
+        atomic_store_explicit(&snapshot->words[i], words[i], memory_order_relaxed);
+    }
+    atomic_store_explicit(&snapshot->sequence, sequence + 2, memory_order_release);
+}
+
+int
+noteSnapshotChange(Book *book, unsigned buyOrSell, Price price){
+    /**
+     * Republish the book's snapshot if the limit at the given price changed
+     * a published level, or may move into them. Returns 1 if it published.
+     */
+    BookSnapshotData *data = &book->snapshot->published;
+    int count = buyOrSell == BUY ? data->bidLevels : data->askLevels;
+    DepthLevel *levels = buyOrSell == BUY ? data->bids : data->asks;
+    if(count == SNAPSHOT_LEVELS && priceIsBehind(buyOrSell, price, levels[count - 1].price)){
+        return 0;
+    }
+    publishBookSnapshot(book);
+    return 1;
+}
+
+int
+tryReadBookSnapshot(BookSnapshot *snapshot, BookSnapshotData *data){
+    /**
+     * Copy the last published data to data in one attempt. Returns 0 if
+     * the copy overlapped a publication and must not be used.
+     */
+    uint64_t words[SNAPSHOT_WORDS];
+    unsigned before, after;
+    size_t i;
+    before = atomic_load_explicit(&snapshot->sequence, memory_order_acquire);
+    if(before & 1){
+        return 0;
+    }
+    for(i=0; i<SNAPSHOT_WORDS; i++){
+        words[i] = atomic_load_explicit(&snapshot->words[i], memory_order_relaxed);
+    }
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&snapshot->sequence, memory_order_relaxed);
+    if(before != after){
+        return 0;
+    }
+    memcpy(data, words, sizeof(BookSnapshotData));
+    return 1;
+}
+
+void
+readBookSnapshot(BookSnapshot *snapshot, BookSnapshotData *data){
+    /**
+     * Copy the last published data to data, retrying while publications
+     * get in the way.
+     */
+    while(!tryReadBookSnapshot(snapshot, data)){
+    }
+}
@@ -2,6 +2,8 @@
 #include <assert.h>
 #include <stdlib.h>
 #include <math.h>
+#include <string.h>
+#include <unistd.h>
 #include "CuTest.h"
 #include "hftlob.h"
 
@@ -40,6 +42,108 @@ createDummyTree(Limit *dummyA, Limit *dummyB, Limit *dummyC, Limit *dummyD){
     return (ptr_root);
 }
 
+/**
+ * Attach a limit to the given parent without balancing the tree, to set
+ * up unbalanced branches.
+ */
+void
+attachDummyLimit(Limit *parent, Limit *child){
+    if(limitIsRoot(parent) || child->limitPrice > parent->limitPrice){
+        parent->rightChild = child;
+    }
+    else{
+        parent->leftChild = child;
+    }
+    child->parent = parent;
+    retraceHeight(parent);
+}
+
+/**
+ * Assert the AVL invariants for the given branch: children are ordered
+ * and link back to their parent, cached heights are correct and the
+ * balance factor is within [-1, 1]. Returns the branch's height.
+ */
+int
+checkTreeInvariants(CuTest *tc, Limit *limit){
+    if(limit == NULL){
+        return -1;
+    }
+    if(limit->leftChild != NULL){
+        CuAssertPtrEquals(tc, limit, limit->leftChild->parent);
+        CuAssertTrue(tc, limit->leftChild->limitPrice < limit->limitPrice);
+    }
+    if(limit->rightChild != NULL){
+        CuAssertPtrEquals(tc, limit, limit->rightChild->parent);
+        CuAssertTrue(tc, limit->rightChild->limitPrice > limit->limitPrice);
+    }
+    int leftHeight = checkTreeInvariants(tc, limit->leftChild);
+    int rightHeight = checkTreeInvariants(tc, limit->rightChild);
+    int height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+    CuAssertIntEquals(tc, height, limit->height);
+    CuAssertTrue(tc, rightHeight - leftHeight <= 1 && rightHeight - leftHeight >= -1);
+    return height;
+}
+
+/**
+ * Assert that the subtree totals of the given branch match the sizes and
+ * volumes of its limits. Returns the branch's total size.
+ */
+Quantity
+checkSubtreeTotals(CuTest *tc, Limit *limit){
+    if(limit == NULL){
+        return 0;
+    }
+    Quantity size = limit->size + checkSubtreeTotals(tc, limit->leftChild)
+                    + checkSubtreeTotals(tc, limit->rightChild);
+    Volume volume = limit->totalVolume;
+    if(limit->leftChild != NULL){
+        volume += limit->leftChild->subtreeVolume;
+    }
+    if(limit->rightChild != NULL){
+        volume += limit->rightChild->subtreeVolume;
+    }
+    CuAssertDblEquals(tc, size, limit->subtreeSize, 0.0);
+    CuAssertDblEquals(tc, volume, limit->subtreeVolume, 0.0);
+    return size;
+}
+
+/**
+ * Assert that following the in-order links from the given root visits
+ * every limit of its tree once, in ascending price order, and that the
+ * links back agree. Returns the number of limits.
+ */
+int
+checkInOrderLinks(CuTest *tc, Limit *root){
+    Limit *limit = root->rightChild != NULL ? getMinimumLimit(root->rightChild) : NULL;
+    Limit *prev = root;
+    int count = 0;
+    CuAssertPtrEquals(tc, limit != NULL ? limit : root, root->nextLimit);
+    while(limit != NULL){
+        CuAssertPtrEquals(tc, prev, limit->prevLimit);
+        CuAssertPtrEquals(tc, getSuccessor(limit), limit->nextLimit == root ? NULL : limit->nextLimit);
+        prev = limit;
+        limit = getSuccessor(limit);
+        if(limit != NULL){
+            CuAssertTrue(tc, limit->limitPrice > prev->limitPrice);
+        }
+        count++;
+    }
+    CuAssertPtrEquals(tc, root, prev->nextLimit);
+    CuAssertPtrEquals(tc, prev, root->prevLimit);
+    return count;
+}
+
+/**
+ * Initialise the given order with side, price and size.
+ */
+void
+initDummyOrder(Order *order, unsigned buyOrSell, Price price, Quantity shares){
+    initOrder(order);
+    order->buyOrSell = buyOrSell;
+    order->limit = price;
+    order->shares = shares;
+}
+
 void
 TestCreateDummyTree(CuTest *tc){
     Limit *ptr_newLimitA = createDummyLimit(100.0);
@@ -84,7 +188,7 @@ TestOrderPushing(CuTest *tc){
     newOrderA.limit = 1000.0;
     newOrderA.shares = 10;
     newOrderA.buyOrSell = 0;
-    newOrderA.tid = "1234";
+    newOrderA.id = 1234;
 
     float expected_volume = 0.0;
     float expected_size = 0;
@@ -120,7 +224,7 @@ TestOrderPushing(CuTest *tc){
     newOrderB.limit = 1000.0;
     newOrderB.shares = 20;
     newOrderB.buyOrSell = 0;
-    newOrderB.tid = "1235";
+    newOrderB.id = 1235;
 
     returnCode = pushOrder(ptr_limit, ptr_newOrderB);
     CuAssertIntEquals(tc, 1, returnCode);
@@ -149,7 +253,7 @@ TestOrderPushing(CuTest *tc){
     newOrderC.limit = 1000.0;
     newOrderC.shares = 30;
     newOrderC.buyOrSell = 0;
-    newOrderC.tid = "1236";
+    newOrderC.id = 1236;
 
     returnCode = pushOrder(ptr_limit, ptr_newOrderC);
     CuAssertIntEquals(tc, 1, returnCode);
@@ -185,7 +289,7 @@ TestOrderPushing(CuTest *tc){
     newOrderC.limit = 2000.0;
     newOrderC.shares = 30;
     newOrderC.buyOrSell = 0;
-    newOrderC.tid = "1236";
+    newOrderC.id = 1236;
     returnCode = pushOrder(ptr_limit, ptr_newOrderD);
     CuAssertIntEquals(tc, 0, returnCode);
 }
@@ -203,7 +307,7 @@ TestOrderPopping(CuTest *tc){
     newOrderA.limit = 1000.0;
     newOrderA.shares = 10;
     newOrderA.buyOrSell = 0;
-    newOrderA.tid = "1234";
+    newOrderA.id = 1234;
 
     Order newOrderB;
     Order *ptr_newOrderB = &newOrderB;
@@ -211,7 +315,7 @@ TestOrderPopping(CuTest *tc){
     newOrderB.limit = 1000.0;
     newOrderB.shares = 20;
     newOrderB.buyOrSell = 0;
-    newOrderB.tid = "1235";
+    newOrderB.id = 1235;
 
     Order newOrderC;
     Order *ptr_newOrderC = &newOrderC;
@@ -219,7 +323,7 @@ TestOrderPopping(CuTest *tc){
     newOrderC.limit = 1000.0;
     newOrderC.shares = 30;
     newOrderC.buyOrSell = 0;
-    newOrderC.tid = "1236";
+    newOrderC.id = 1236;
 
     pushOrder(ptr_limit, ptr_newOrderA);
     pushOrder(ptr_limit, ptr_newOrderB);
@@ -306,7 +410,7 @@ TestRemoveOrder(CuTest *tc){
     newOrderA.limit = 1000.0;
     newOrderA.shares = 10;
     newOrderA.buyOrSell = 0;
-    newOrderA.tid = "1234";
+    newOrderA.id = 1234;
 
     Order newOrderB;
     Order *ptr_newOrderB = &newOrderB;
@@ -314,7 +418,7 @@ TestRemoveOrder(CuTest *tc){
     newOrderB.limit = 1000.0;
     newOrderB.shares = 20;
     newOrderB.buyOrSell = 0;
-    newOrderB.tid = "1235";
+    newOrderB.id = 1235;
 
     Order newOrderC;
     Order *ptr_newOrderC = &newOrderC;
@@ -322,7 +426,7 @@ TestRemoveOrder(CuTest *tc){
     newOrderC.limit = 1000.0;
     newOrderC.shares = 30;
     newOrderC.buyOrSell = 0;
-    newOrderC.tid = "1236";
+    newOrderC.id = 1236;
 
     int returnCode = 0;
 
@@ -368,12 +472,12 @@ TestRemoveOrder(CuTest *tc){
 void
 TestCreateRoot(CuTest *tc){
     /**
-     * Test the createRoot() function and assert it creates a root with limitPrice of -INFINITY, no children
+     * Test the createRoot() function and assert it creates a root with limitPrice of MIN_PRICE, no children
      * and no parent.
      */
     Limit *ptr_root = createRoot();
     CuAssertPtrEquals(tc, NULL, ptr_root->parent);
-    CuAssertTrue(tc, isinf(ptr_root->limitPrice));
+    CuAssertTrue(tc, ptr_root->limitPrice == MIN_PRICE);
     CuAssertPtrEquals(tc, NULL, ptr_root->leftChild);
     CuAssertPtrEquals(tc, NULL, ptr_root->rightChild);
 }
@@ -652,16 +756,56 @@ TestGetBalanceFactor(CuTest *tc){
     ptr_newLimitD->limitPrice = 45.0;
     ptr_root = createDummyTree(ptr_newLimitA, ptr_newLimitB, ptr_newLimitC, ptr_newLimitD);
 
+    /**
+     * Adding 250 made the branch at 100 right-heavy, so it was rotated and 200 is now on top.
+     */
+    CuAssertPtrEquals(tc, ptr_newLimitB, ptr_root->rightChild);
     balanceFactor = getBalanceFactor(ptr_newLimitA);
-    CuAssertIntEquals(tc, 1, balanceFactor);
+    CuAssertIntEquals(tc, -1, balanceFactor);
     balanceFactor = getBalanceFactor(ptr_newLimitB);
-    CuAssertIntEquals(tc, 1, balanceFactor);
+    CuAssertIntEquals(tc, -1, balanceFactor);
     balanceFactor = getBalanceFactor(ptr_newLimitC);
     CuAssertIntEquals(tc, 0, balanceFactor);
     balanceFactor = getBalanceFactor(ptr_newLimitD);
     CuAssertIntEquals(tc, 0, balanceFactor);
 }
 
+void
+TestHeightMaintenance(CuTest *tc){
+    // Setup the BST Tree
+    Limit *ptr_newLimitA = createDummyLimit(100.0);
+    Limit *ptr_newLimitB = createDummyLimit(50.0);
+    Limit *ptr_newLimitC = createDummyLimit(40.0);
+    Limit *ptr_root = createRoot();
+
+    attachDummyLimit(ptr_root, ptr_newLimitA);
+    attachDummyLimit(ptr_newLimitA, ptr_newLimitB);
+    attachDummyLimit(ptr_newLimitB, ptr_newLimitC);
+
+    /**
+     * Assert that the cached heights are updated by insertions, rotations and removals.
+     */
+    CuAssertIntEquals(tc, 3, getHeight(ptr_root));
+    CuAssertIntEquals(tc, 2, getHeight(ptr_newLimitA));
+    CuAssertIntEquals(tc, 1, getHeight(ptr_newLimitB));
+    CuAssertIntEquals(tc, 0, getHeight(ptr_newLimitC));
+
+    rotateLeftLeft(ptr_newLimitA);
+    CuAssertIntEquals(tc, 2, getHeight(ptr_root));
+    CuAssertIntEquals(tc, 1, getHeight(ptr_newLimitB));
+    CuAssertIntEquals(tc, 0, getHeight(ptr_newLimitA));
+    CuAssertIntEquals(tc, 0, getHeight(ptr_newLimitC));
+
+    removeLimit(ptr_newLimitC);
+    CuAssertIntEquals(tc, 2, getHeight(ptr_root));
+    CuAssertIntEquals(tc, 1, getHeight(ptr_newLimitB));
+
+    removeLimit(ptr_newLimitB);
+    CuAssertIntEquals(tc, 1, getHeight(ptr_root));
+    CuAssertIntEquals(tc, 0, getHeight(ptr_newLimitA));
+    CuAssertIntEquals(tc, -1, getHeight(NULL));
+}
+
 /**
  * Test the tree operation functions.
  */
@@ -704,18 +848,23 @@ TestRemoveLimit(CuTest *tc){
 
     statusCode = removeLimit(ptr_newLimitB);
     CuAssertIntEquals(tc, 1, statusCode);
-    CuAssertPtrEquals(tc, NULL,  ptr_root->rightChild->rightChild);
-    CuAssertPtrEquals(tc, ptr_newLimitC, ptr_root->rightChild->leftChild);
+    /* Removing 200 leaves 100 left-heavy, so 50 is rotated on top. */
+    CuAssertPtrEquals(tc, ptr_newLimitC, ptr_root->rightChild);
+    CuAssertPtrEquals(tc, ptr_newLimitD, ptr_root->rightChild->leftChild);
+    CuAssertPtrEquals(tc, ptr_newLimitA, ptr_root->rightChild->rightChild);
+    checkTreeInvariants(tc, ptr_root->rightChild);
 
 
     /**
-     * TestCase2: Remove a limit which has a single child and parent
+     * TestCase2: Remove a limit which has two children and the root as parent
      */
 
     statusCode = removeLimit(ptr_newLimitC);
     CuAssertIntEquals(tc, 1, statusCode);
+    CuAssertPtrEquals(tc, ptr_newLimitA, ptr_root->rightChild);
     CuAssertPtrEquals(tc, NULL, ptr_root->rightChild->rightChild);
     CuAssertPtrEquals(tc, ptr_newLimitD, ptr_root->rightChild->leftChild);
+    checkTreeInvariants(tc, ptr_root->rightChild);
 
     /**
      * TestCase3: Remove a limit with two children and a parent.
@@ -731,10 +880,12 @@ TestRemoveLimit(CuTest *tc){
 
     statusCode = removeLimit(ptr_LimitA);
     CuAssertIntEquals(tc, 1, statusCode);
-    CuAssertPtrEquals(tc, ptr_LimitB, ptr_rootB->rightChild);
-    CuAssertPtrEquals(tc, NULL, ptr_rootB->rightChild->rightChild);
-    CuAssertPtrEquals(tc, ptr_LimitC, ptr_rootB->rightChild->leftChild);
-    CuAssertPtrEquals(tc, ptr_LimitD, ptr_rootB->rightChild->leftChild->leftChild);
+    CuAssertPtrEquals(tc, ptr_LimitC, ptr_rootB->rightChild);
+    CuAssertPtrEquals(tc, ptr_LimitB, ptr_rootB->rightChild->rightChild);
+    CuAssertPtrEquals(tc, ptr_LimitD, ptr_rootB->rightChild->leftChild);
+    CuAssertPtrEquals(tc, ptr_rootB, ptr_LimitC->parent);
+    CuAssertPtrEquals(tc, ptr_LimitC, ptr_LimitB->parent);
+    checkTreeInvariants(tc, ptr_rootB->rightChild);
 }
 
 void
@@ -745,14 +896,9 @@ TestRotateLL(CuTest *tc){
     Limit *ptr_newLimitC = createDummyLimit(40.0);
     Limit *ptr_root = createRoot();
 
-    int statusCode = 0;
-
-    statusCode = addNewLimit(ptr_root, ptr_newLimitA);
-    CuAssertIntEquals(tc, 1, statusCode);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitB);
-    CuAssertIntEquals(tc, 1, statusCode);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitC);
-    CuAssertIntEquals(tc, 1, statusCode);
+    attachDummyLimit(ptr_root, ptr_newLimitA);
+    attachDummyLimit(ptr_newLimitA, ptr_newLimitB);
+    attachDummyLimit(ptr_newLimitB, ptr_newLimitC);
 
     /**
      * Assert that all references are correctly updated and the pointers are correct.
@@ -783,14 +929,9 @@ TestRotateLR(CuTest *tc){
     Limit *ptr_newLimitC = createDummyLimit(60.0);
     Limit *ptr_root = createRoot();
 
-    int statusCode = 0;
-
-    statusCode = addNewLimit(ptr_root, ptr_newLimitA);
-    CuAssertIntEquals(tc, 1, statusCode);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitB);
-    CuAssertIntEquals(tc, 1, statusCode);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitC);
-    CuAssertIntEquals(tc, 1, statusCode);
+    attachDummyLimit(ptr_root, ptr_newLimitA);
+    attachDummyLimit(ptr_newLimitA, ptr_newLimitB);
+    attachDummyLimit(ptr_newLimitB, ptr_newLimitC);
 
     /**
      * Assert that all references are correctly updated and the pointers are correct.
@@ -821,14 +962,9 @@ TestRotateRR(CuTest *tc){
     Limit *ptr_newLimitC = createDummyLimit(300.0);
     Limit *ptr_root = createRoot();
 
-    int statusCode = 0;
-
-    statusCode = addNewLimit(ptr_root, ptr_newLimitA);
-    CuAssertIntEquals(tc, statusCode, 1);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitB);
-    CuAssertIntEquals(tc, statusCode, 1);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitC);
-    CuAssertIntEquals(tc, statusCode, 1);
+    attachDummyLimit(ptr_root, ptr_newLimitA);
+    attachDummyLimit(ptr_newLimitA, ptr_newLimitB);
+    attachDummyLimit(ptr_newLimitB, ptr_newLimitC);
 
     rotateRightRight(ptr_newLimitA);
 
@@ -855,14 +991,9 @@ TestRotateRL(CuTest *tc){
     Limit *ptr_newLimitC = createDummyLimit(150.0);
     Limit *ptr_root = createRoot();
 
-    int statusCode = 0;
-
-    statusCode = addNewLimit(ptr_root, ptr_newLimitA);
-    CuAssertIntEquals(tc, statusCode, 1);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitB);
-    CuAssertIntEquals(tc, statusCode, 1);
-    statusCode = addNewLimit(ptr_root, ptr_newLimitC);
-    CuAssertIntEquals(tc, statusCode, 1);
+    attachDummyLimit(ptr_root, ptr_newLimitA);
+    attachDummyLimit(ptr_newLimitA, ptr_newLimitB);
+    attachDummyLimit(ptr_newLimitB, ptr_newLimitC);
 
     /**
      * Assert that all references are correctly updated and the pointers are correct.
@@ -887,9 +1018,2156 @@ TestRotateRL(CuTest *tc){
 
 void
 TestBalanceBranch(CuTest *tc){
-    CuFail(tc, "Finish this test!\n");
+    // Setup an unbalanced branch: 100 -> 200 -> 300
+    Limit *ptr_newLimitA = createDummyLimit(100.0);
+    Limit *ptr_newLimitB = createDummyLimit(200.0);
+    Limit *ptr_newLimitC = createDummyLimit(300.0);
+    Limit *ptr_root = createRoot();
+    attachDummyLimit(ptr_root, ptr_newLimitA);
+    attachDummyLimit(ptr_newLimitA, ptr_newLimitB);
+    attachDummyLimit(ptr_newLimitB, ptr_newLimitC);
+    CuAssertIntEquals(tc, 2, getBalanceFactor(ptr_newLimitA));
+
+    /**
+     * Assert that balanceBranch() rotates the branch and leaves balanced branches untouched.
+     */
+    balanceBranch(ptr_newLimitA);
+    CuAssertPtrEquals(tc, ptr_newLimitB, ptr_root->rightChild);
+    CuAssertPtrEquals(tc, ptr_newLimitA, ptr_newLimitB->leftChild);
+    CuAssertPtrEquals(tc, ptr_newLimitC, ptr_newLimitB->rightChild);
+    checkTreeInvariants(tc, ptr_root->rightChild);
+
+    balanceBranch(ptr_newLimitB);
+    CuAssertPtrEquals(tc, ptr_newLimitB, ptr_root->rightChild);
+}
+
+void
+TestBalancedInsert(CuTest *tc){
+    /**
+     * Insert trending prices, which would degenerate an unbalanced tree into a list,
+     * and assert the tree stays balanced after every insertion.
+     */
+    int count = 1000;
+    Limit *limits = malloc(count * sizeof(Limit));
+    Limit *ptr_root = createRoot();
+    int i;
+    for(i=0; i<count; i++){
+        initLimit(&limits[i]);
+        limits[i].limitPrice = 100.0 + i;
+        CuAssertIntEquals(tc, 1, addNewLimit(ptr_root, &limits[i]));
+        if(i % 97 == 0){
+            checkTreeInvariants(tc, ptr_root->rightChild);
+        }
+    }
+    checkTreeInvariants(tc, ptr_root->rightChild);
+    /* An AVL tree of 1000 nodes is at most 1.44 * log2(1000) high. */
+    CuAssertTrue(tc, getHeight(ptr_root->rightChild) <= 14);
+    CuAssertPtrEquals(tc, &limits[count-1], getMaximumLimit(ptr_root));
+    CuAssertPtrEquals(tc, &limits[0], getMinimumLimit(ptr_root));
+    free(ptr_root);
+    free(limits);
+}
+
+void
+TestBalancedRemove(CuTest *tc){
+    /**
+     * Add limits on one end of the tree while removing them from the other, as a trending
+     * market does, and assert the tree stays balanced.
+     */
+    int window = 200;
+    int count = 2000;
+    Limit *limits = malloc(count * sizeof(Limit));
+    Limit *ptr_root = createRoot();
+    int i;
+    for(i=0; i<count; i++){
+        initLimit(&limits[i]);
+        limits[i].limitPrice = 100.0 + i;
+        addNewLimit(ptr_root, &limits[i]);
+        if(i >= window){
+            CuAssertIntEquals(tc, 1, removeLimit(&limits[i-window]));
+        }
+        if(i % 89 == 0){
+            checkTreeInvariants(tc, ptr_root->rightChild);
+            checkSubtreeTotals(tc, ptr_root->rightChild);
+            CuAssertIntEquals(tc, i >= window ? window : i + 1, checkInOrderLinks(tc, ptr_root));
+        }
+    }
+    checkTreeInvariants(tc, ptr_root->rightChild);
+    CuAssertTrue(tc, getHeight(ptr_root->rightChild) <= 10);
+    CuAssertPtrEquals(tc, &limits[count-window], getMinimumLimit(ptr_root));
+
+    /**
+     * Remove limits with two children from the middle of the tree.
+     */
+    for(i=count-window; i<count; i+=3){
+        removeLimit(&limits[i]);
+        checkTreeInvariants(tc, ptr_root->rightChild);
+        checkInOrderLinks(tc, ptr_root);
+    }
+    free(ptr_root);
+    free(limits);
+}
+
+
+/**
+ * Test the Book operations.
+ */
+
+void
+TestBookAddOrder(CuTest *tc){
+    Book book;
+    initBook(&book);
+    Order orders[5];
+    initDummyOrder(&orders[0], BUY, 100.0, 10);
+    initDummyOrder(&orders[1], BUY, 101.0, 20);
+    initDummyOrder(&orders[2], BUY, 99.0, 30);
+    initDummyOrder(&orders[3], SELL, 103.0, 40);
+    initDummyOrder(&orders[4], SELL, 102.0, 50);
+
+    int i;
+    for(i=0; i<5; i++){
+        CuAssertIntEquals(tc, 1, addOrder(&book, &orders[i]));
+    }
+
+    /**
+     * Assert that the inside of the book is cached and points to the limits holding the orders.
+     */
+    CuAssertPtrEquals(tc, orders[1].parentLimit, getBestBid(&book));
+    CuAssertPtrEquals(tc, orders[4].parentLimit, getBestOffer(&book));
+    CuAssertDblEquals(tc, 101.0, book.highestBuy->limitPrice, 0.0);
+    CuAssertDblEquals(tc, 102.0, book.lowestSell->limitPrice, 0.0);
+
+    /**
+     * Adding to an existing limit must not create a new one.
+     */
+    Order sameLimit;
+    initDummyOrder(&sameLimit, BUY, 101.0, 5);
+    CuAssertIntEquals(tc, 1, addOrder(&book, &sameLimit));
+    CuAssertPtrEquals(tc, orders[1].parentLimit, sameLimit.parentLimit);
+    CuAssertIntEquals(tc, 2, book.highestBuy->orderCount);
+    CuAssertDblEquals(tc, 25.0, book.highestBuy->size, 0.0);
+
+    /**
+     * Orders without a valid side are rejected.
+     */
+    Order noSide;
+    initOrder(&noSide);
+    CuAssertIntEquals(tc, 0, addOrder(&book, &noSide));
+
+    destroyBook(&book);
+}
+
+void
+TestBookCancelOrder(CuTest *tc){
+    Book book;
+    initBook(&book);
+    Order orders[4];
+    initDummyOrder(&orders[0], BUY, 100.0, 10);
+    initDummyOrder(&orders[1], BUY, 101.0, 20);
+    initDummyOrder(&orders[2], BUY, 101.0, 30);
+    initDummyOrder(&orders[3], BUY, 99.0, 40);
+
+    int i;
+    for(i=0; i<4; i++){
+        addOrder(&book, &orders[i]);
+    }
+
+    /**
+     * Cancelling one of two orders at the inside keeps the limit and updates its size.
+     */
+    CuAssertIntEquals(tc, 1, cancelOrder(&book, &orders[1]));
+    CuAssertPtrEquals(tc, NULL, orders[1].parentLimit);
+    CuAssertDblEquals(tc, 101.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertIntEquals(tc, 1, getBestBid(&book)->orderCount);
+    CuAssertDblEquals(tc, 30.0, getBestBid(&book)->size, 0.0);
+
+    /**
+     * Cancelling the last order at the inside moves the best bid to the next limit.
+     */
+    CuAssertIntEquals(tc, 1, cancelOrder(&book, &orders[2]));
+    CuAssertDblEquals(tc, 100.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertPtrEquals(tc, NULL, findLimit(book.buyTree, 101.0));
+
+    CuAssertIntEquals(tc, 1, cancelOrder(&book, &orders[0]));
+    CuAssertDblEquals(tc, 99.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertIntEquals(tc, 1, cancelOrder(&book, &orders[3]));
+    CuAssertPtrEquals(tc, NULL, getBestBid(&book));
+    CuAssertPtrEquals(tc, NULL, book.buyTree->rightChild);
+
+    /**
+     * Cancelling an order which is not in the book fails.
+     */
+    CuAssertIntEquals(tc, 0, cancelOrder(&book, &orders[3]));
+
+    destroyBook(&book);
+}
+
+void
+TestBookExecuteOrder(CuTest *tc){
+    Book book;
+    initBook(&book);
+    Order orders[4];
+    initDummyOrder(&orders[0], SELL, 100.0, 10);
+    initDummyOrder(&orders[1], SELL, 100.0, 20);
+    initDummyOrder(&orders[2], SELL, 105.0, 30);
+    initDummyOrder(&orders[3], SELL, 102.0, 40);
+
+    int i;
+    for(i=0; i<4; i++){
+        addOrder(&book, &orders[i]);
+    }
+
+    /**
+     * Executions take the oldest order at the lowest sell first and move the inside up.
+     */
+    CuAssertPtrEquals(tc, &orders[0], executeOrder(&book, SELL));
+    CuAssertDblEquals(tc, 100.0, getBestOffer(&book)->limitPrice, 0.0);
+    CuAssertPtrEquals(tc, &orders[1], executeOrder(&book, SELL));
+    CuAssertDblEquals(tc, 102.0, getBestOffer(&book)->limitPrice, 0.0);
+    CuAssertPtrEquals(tc, &orders[3], executeOrder(&book, SELL));
+    CuAssertDblEquals(tc, 105.0, getBestOffer(&book)->limitPrice, 0.0);
+    CuAssertPtrEquals(tc, &orders[2], executeOrder(&book, SELL));
+    CuAssertPtrEquals(tc, NULL, getBestOffer(&book));
+    CuAssertPtrEquals(tc, NULL, executeOrder(&book, SELL));
+    CuAssertPtrEquals(tc, NULL, executeOrder(&book, BUY));
+
+    destroyBook(&book);
+}
+
+void
+TestBookModifyOrder(CuTest *tc){
+    Book book;
+    initBook(&book);
+    reserveOrders(&book, 16);
+    Order orders[3];
+    initDummyOrder(&orders[0], BUY, 100.0, 10);
+    initDummyOrder(&orders[1], BUY, 100.0, 20);
+    initDummyOrder(&orders[2], BUY, 99.0, 5);
+    int i;
+    for(i=0; i<3; i++){
+        orders[i].id = i + 1;
+        addOrder(&book, &orders[i]);
+    }
+    Limit *limit = getBestBid(&book);
+
+    /**
+     * A size reduction keeps the order's queue position.
+     */
+    CuAssertIntEquals(tc, 1, modifyOrder(&book, &orders[0], 100.0, 4));
+    CuAssertDblEquals(tc, 4.0, orders[0].shares, 0.0);
+    CuAssertPtrEquals(tc, &orders[0], limit->tailOrder);
+    CuAssertDblEquals(tc, 24.0, limit->size, 0.0);
+    CuAssertDblEquals(tc, 2400.0, limit->totalVolume, 0.0);
+
+    /**
+     * A size increase moves the order to the back of the queue at the same limit.
+     */
+    CuAssertIntEquals(tc, 1, modifyOrder(&book, &orders[0], 100.0, 30));
+    CuAssertPtrEquals(tc, limit, getBestBid(&book));
+    CuAssertPtrEquals(tc, &orders[1], limit->tailOrder);
+    CuAssertPtrEquals(tc, &orders[0], limit->headOrder);
+    CuAssertDblEquals(tc, 50.0, limit->size, 0.0);
+    CuAssertIntEquals(tc, 2, limit->orderCount);
+
+    /**
+     * A price change requeues the order at the new price, reusing an existing limit.
+     */
+    CuAssertIntEquals(tc, 1, modifyOrder(&book, &orders[1], 101.0, 20));
+    CuAssertDblEquals(tc, 101.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertPtrEquals(tc, &orders[1], getOrderById(&book, 2));
+    Limit *lower = orders[2].parentLimit;
+    CuAssertIntEquals(tc, 1, modifyOrder(&book, &orders[0], 99.0, 30));
+    CuAssertPtrEquals(tc, lower, orders[0].parentLimit);
+    CuAssertPtrEquals(tc, &orders[0], lower->headOrder);
+    CuAssertDblEquals(tc, 35.0, lower->size, 0.0);
+    CuAssertPtrEquals(tc, NULL, findLimit(book.buyTree, 100.0));
+    CuAssertPtrEquals(tc, &orders[0], getOrderById(&book, 1));
+
+    /**
+     * Modifying to no size or modifying an order not in the book fails.
+     */
+    CuAssertIntEquals(tc, 0, modifyOrder(&book, &orders[0], 99.0, 0));
+    cancelOrder(&book, &orders[2]);
+    CuAssertIntEquals(tc, 0, modifyOrder(&book, &orders[2], 99.0, 5));
+    CuAssertDblEquals(tc, 30.0, lower->size, 0.0);
+
+    destroyBook(&book);
 }
 
+/**
+ * Test the order id index.
+ */
+
+void
+TestOrderMap(CuTest *tc){
+    OrderMap map;
+    int count = 1000;
+    Order *orders = malloc(count * sizeof(Order));
+    int i;
+
+    CuAssertIntEquals(tc, 1, initOrderMap(&map, count));
+    CuAssertTrue(tc, map.maxCount >= (size_t)count);
+
+    /**
+     * Insert sequential ids, as exchanges hand them out, and assert every one can be found.
+     */
+    for(i=0; i<count; i++){
+        initOrder(&orders[i]);
+        orders[i].id = 1000000 + i;
+        CuAssertIntEquals(tc, 1, insertIntoOrderMap(&map, &orders[i]));
+    }
+    CuAssertIntEquals(tc, count, (int)map.count);
+    CuAssertIntEquals(tc, 0, insertIntoOrderMap(&map, &orders[7]));
+    for(i=0; i<count; i++){
+        CuAssertPtrEquals(tc, &orders[i], getFromOrderMap(&map, 1000000 + i));
+    }
+    CuAssertPtrEquals(tc, NULL, getFromOrderMap(&map, 42));
+
+    /**
+     * Remove every other order and assert the remaining ones are still found after the
+     * backward shifts.
+     */
+    for(i=0; i<count; i+=2){
+        CuAssertPtrEquals(tc, &orders[i], removeFromOrderMap(&map, 1000000 + i));
+    }
+    CuAssertPtrEquals(tc, NULL, removeFromOrderMap(&map, 1000000));
+    for(i=0; i<count; i++){
+        CuAssertPtrEquals(tc, i % 2 ? &orders[i] : NULL, getFromOrderMap(&map, 1000000 + i));
+    }
+
+    /**
+     * Assert that the map refuses inserts instead of rehashing once it is full.
+     */
+    for(i=0; i<count; i+=2){
+        insertIntoOrderMap(&map, &orders[i]);
+    }
+    Order *extras = malloc((map.maxCount - map.count) * sizeof(Order));
+    Order *extra = extras;
+    while(map.count < map.maxCount){
+        initOrder(extra);
+        extra->id = 5000000 + map.count;
+        CuAssertIntEquals(tc, 1, insertIntoOrderMap(&map, extra));
+        extra++;
+    }
+    Order overflow;
+    initOrder(&overflow);
+    overflow.id = 1;
+    CuAssertIntEquals(tc, 0, insertIntoOrderMap(&map, &overflow));
+
+    destroyOrderMap(&map);
+    free(extras);
+    free(orders);
+}
+
+void
+TestTidMap(CuTest *tc){
+    TidMap map;
+    CuAssertIntEquals(tc, 1, initTidMap(&map, 16));
+
+    /**
+     * Assert that the same tid is always interned to the same id and that ids are unique.
+     */
+    uint64_t idA = internTid(&map, "order-a");
+    uint64_t idB = internTid(&map, "order-b");
+    CuAssertTrue(tc, idA != 0);
+    CuAssertTrue(tc, idB != 0);
+    CuAssertTrue(tc, idA != idB);
+    char copy[] = "order-a";
+    CuAssertTrue(tc, idA == internTid(&map, copy));
+    CuAssertTrue(tc, idA == lookupTid(&map, "order-a"));
+    CuAssertTrue(tc, 0 == lookupTid(&map, "order-c"));
+
+    CuAssertTrue(tc, idA == releaseTid(&map, "order-a"));
+    CuAssertTrue(tc, 0 == lookupTid(&map, "order-a"));
+    CuAssertTrue(tc, idB == lookupTid(&map, "order-b"));
+
+    destroyTidMap(&map);
+}
+
+void
+TestBookOrdersById(CuTest *tc){
+    Book book;
+    initBook(&book);
+    CuAssertIntEquals(tc, 1, reserveOrders(&book, 64));
+
+    Order orders[3];
+    initDummyOrder(&orders[0], BUY, 100.0, 10);
+    initDummyOrder(&orders[1], BUY, 100.0, 20);
+    initDummyOrder(&orders[2], SELL, 101.0, 30);
+    int i;
+    for(i=0; i<3; i++){
+        orders[i].id = 11 + i;
+        CuAssertIntEquals(tc, 1, addOrder(&book, &orders[i]));
+    }
+
+    /**
+     * Duplicate ids are rejected.
+     */
+    Order duplicate;
+    initDummyOrder(&duplicate, BUY, 99.0, 5);
+    duplicate.id = 11;
+    CuAssertIntEquals(tc, 0, addOrder(&book, &duplicate));
+    CuAssertPtrEquals(tc, &orders[0], getOrderById(&book, 11));
+
+    /**
+     * A partial execution keeps the order in place, a full one removes it.
+     */
+    CuAssertPtrEquals(tc, &orders[0], executeOrderById(&book, 11, 4));
+    CuAssertDblEquals(tc, 6.0, orders[0].shares, 0.0);
+    CuAssertDblEquals(tc, 26.0, getBestBid(&book)->size, 0.0);
+    CuAssertPtrEquals(tc, &orders[0], getBestBid(&book)->tailOrder);
+    CuAssertPtrEquals(tc, &orders[0], executeOrderById(&book, 11, 6));
+    CuAssertPtrEquals(tc, NULL, getOrderById(&book, 11));
+    CuAssertPtrEquals(tc, &orders[1], getBestBid(&book)->tailOrder);
+
+    CuAssertPtrEquals(tc, &orders[1], cancelOrderById(&book, 12));
+    CuAssertPtrEquals(tc, NULL, getBestBid(&book));
+    CuAssertPtrEquals(tc, NULL, cancelOrderById(&book, 12));
+
+    CuAssertPtrEquals(tc, &orders[2], executeOrder(&book, SELL));
+    CuAssertPtrEquals(tc, NULL, getOrderById(&book, 13));
+    CuAssertIntEquals(tc, 0, (int)book.orders.count);
+
+    destroyBook(&book);
+}
+
+/**
+ * Test the instrument conversions.
+ */
+
+void
+TestInstrumentConversions(CuTest *tc){
+    Instrument instrument;
+    initInstrument(&instrument, 0.01, 0.001);
+
+    /**
+     * Prices and quantities are rounded to the nearest tick and lot, and convert back exactly.
+     */
+    Price price = toPrice(&instrument, 100.254);
+    CuAssertDblEquals(tc, 100.25, fromPrice(&instrument, price), 1e-9);
+    CuAssertTrue(tc, price == toPrice(&instrument, 100.2501));
+    CuAssertTrue(tc, price < toPrice(&instrument, 100.26));
+    Quantity quantity = toQuantity(&instrument, 1.2345);
+    CuAssertDblEquals(tc, 1.235, fromQuantity(&instrument, quantity), 1e-9);
+#ifdef HFTLOB_FIXED_POINT
+    CuAssertTrue(tc, 10025 == price);
+    CuAssertTrue(tc, 1235 == quantity);
+#endif
+
+    /**
+     * Adding and removing the same quantities many times leaves no residue in the limit.
+     */
+    Limit limit;
+    initLimit(&limit);
+    limit.limitPrice = price;
+    Order orders[10];
+    int i, pass;
+    for(pass=0; pass<100; pass++){
+        for(i=0; i<10; i++){
+            initDummyOrder(&orders[i], BUY, price, toQuantity(&instrument, 0.1 + 0.001 * i));
+            pushOrder(&limit, &orders[i]);
+        }
+        for(i=0; i<10; i++){
+            removeOrder(&orders[i]);
+        }
+    }
+    CuAssertIntEquals(tc, 0, limit.orderCount);
+#ifdef HFTLOB_FIXED_POINT
+    CuAssertTrue(tc, 0 == limit.size);
+    CuAssertTrue(tc, 0 == limit.totalVolume);
+#else
+    CuAssertDblEquals(tc, 0.0, limit.size, 1e-9);
+#endif
+}
+
+/**
+ * Test the occupancy bitmap.
+ */
+
+void
+TestBitmap(CuTest *tc){
+    /**
+     * Set and clear random bits of a three level bitmap and assert the nearest set bit
+     * below and above random indices matches a linear scan.
+     */
+    Bitmap bitmap;
+    int size = 5000;
+    CuAssertIntEquals(tc, 1, initBitmap(&bitmap, size));
+    CuAssertIntEquals(tc, 3, bitmap.levels);
+    CuAssertTrue(tc, -1 == findBitmapBitAtOrBelow(&bitmap, size - 1));
+    CuAssertTrue(tc, -1 == findBitmapBitAtOrAbove(&bitmap, 0));
+
+    char *reference = calloc(size, 1);
+    int step, i, index;
+    int64_t below, above;
+    srand(7);
+    for(step=0; step<4000; step++){
+        index = rand() % size;
+        if(rand() % 3 == 0){
+            clearBitmapBit(&bitmap, index);
+            reference[index] = 0;
+        }
+        else{
+            setBitmapBit(&bitmap, index);
+            reference[index] = 1;
+        }
+        /* Keep the bitmap sparse half of the time to exercise the upper levels. */
+        if(step % 2000 == 1000){
+            for(i=0; i<size; i++){
+                if(reference[i] && rand() % 50 != 0){
+                    clearBitmapBit(&bitmap, i);
+                    reference[i] = 0;
+                }
+            }
+        }
+
+        index = rand() % size;
+        below = -1;
+        for(i=index; i>=0; i--){
+            if(reference[i]){
+                below = i;
+                break;
+            }
+        }
+        above = -1;
+        for(i=index; i<size; i++){
+            if(reference[i]){
+                above = i;
+                break;
+            }
+        }
+        CuAssertTrue(tc, below == findBitmapBitAtOrBelow(&bitmap, index));
+        CuAssertTrue(tc, above == findBitmapBitAtOrAbove(&bitmap, index));
+    }
+
+    free(reference);
+    destroyBitmap(&bitmap);
+}
+
+/**
+ * Test the matching engine.
+ */
+
+void
+TestSubmitOrder(CuTest *tc){
+    Book book;
+    initBook(&book);
+    Order resting[3];
+    initDummyOrder(&resting[0], SELL, 101, 10);
+    initDummyOrder(&resting[1], SELL, 101, 20);
+    initDummyOrder(&resting[2], SELL, 102, 5);
+    int i;
+    for(i=0; i<3; i++){
+        resting[i].id = i + 1;
+        addOrder(&book, &resting[i]);
+    }
+    Fill fills[4];
+    size_t fillCount;
+
+    /**
+     * An order which does not cross rests without fills.
+     */
+    Order bid;
+    initDummyOrder(&bid, BUY, 100, 7);
+    CuAssertIntEquals(tc, 1, submitOrder(&book, &bid, ORDER_LIMIT, fills, 4, &fillCount));
+    CuAssertIntEquals(tc, 0, (int)fillCount);
+    CuAssertPtrEquals(tc, bid.parentLimit, getBestBid(&book));
+
+    /**
+     * Fills are taken oldest first at the best price, and a partially filled maker keeps its place.
+     */
+    Order taker;
+    initDummyOrder(&taker, BUY, 102, 25);
+    taker.id = 10;
+    CuAssertIntEquals(tc, 1, submitOrder(&book, &taker, ORDER_LIMIT, fills, 4, &fillCount));
+    CuAssertIntEquals(tc, 2, (int)fillCount);
+    CuAssertPtrEquals(tc, &resting[0], fills[0].maker);
+    CuAssertTrue(tc, 10 == fills[0].takerId && 1 == fills[0].makerId);
+    CuAssertDblEquals(tc, 101.0, fills[0].price, 0.0);
+    CuAssertDblEquals(tc, 10.0, fills[0].shares, 0.0);
+    CuAssertIntEquals(tc, 1, fills[0].makerFilled);
+    CuAssertPtrEquals(tc, NULL, resting[0].parentLimit);
+    CuAssertPtrEquals(tc, &resting[1], fills[1].maker);
+    CuAssertDblEquals(tc, 15.0, fills[1].shares, 0.0);
+    CuAssertIntEquals(tc, 0, fills[1].makerFilled);
+    CuAssertDblEquals(tc, 5.0, resting[1].shares, 0.0);
+    CuAssertDblEquals(tc, 5.0, getBestOffer(&book)->size, 0.0);
+    CuAssertDblEquals(tc, 0.0, taker.shares, 0.0);
+    CuAssertPtrEquals(tc, NULL, taker.parentLimit);
+
+    /**
+     * A full fill buffer stops matching; resubmitting sweeps the next level and rests the rest.
+     */
+    initDummyOrder(&taker, BUY, 102, 30);
+    CuAssertIntEquals(tc, -1, submitOrder(&book, &taker, ORDER_LIMIT, fills, 1, &fillCount));
+    CuAssertIntEquals(tc, 1, (int)fillCount);
+    CuAssertDblEquals(tc, 25.0, taker.shares, 0.0);
+    CuAssertPtrEquals(tc, NULL, taker.parentLimit);
+    CuAssertDblEquals(tc, 102.0, getBestOffer(&book)->limitPrice, 0.0);
+    CuAssertIntEquals(tc, 1, submitOrder(&book, &taker, ORDER_LIMIT, fills, 4, &fillCount));
+    CuAssertIntEquals(tc, 1, (int)fillCount);
+    CuAssertPtrEquals(tc, &resting[2], fills[0].maker);
+    CuAssertPtrEquals(tc, NULL, getBestOffer(&book));
+    CuAssertPtrEquals(tc, taker.parentLimit, getBestBid(&book));
+    CuAssertDblEquals(tc, 20.0, getBestBid(&book)->size, 0.0);
+
+    destroyBook(&book);
+}
+
+void
+TestSubmitOrderTypes(CuTest *tc){
+    Book book;
+    initBook(&book);
+    Order resting[4];
+    initDummyOrder(&resting[0], SELL, 101, 5);
+    initDummyOrder(&resting[1], SELL, 101, 5);
+    initDummyOrder(&resting[2], SELL, 102, 10);
+    initDummyOrder(&resting[3], SELL, 104, 10);
+    int i;
+    for(i=0; i<4; i++){
+        addOrder(&book, &resting[i]);
+    }
+    Fill fills[8];
+    size_t fillCount, maxFillsNeeded;
+
+    /**
+     * The fillable size is summed over the crossed limits.
+     */
+    CuAssertDblEquals(tc, 20.0, getFillableShares(&book, BUY, 102, 100, &maxFillsNeeded), 0.0);
+    CuAssertIntEquals(tc, 3, (int)maxFillsNeeded);
+    CuAssertDblEquals(tc, 7.0, getFillableShares(&book, BUY, 104, 7, &maxFillsNeeded), 0.0);
+    CuAssertIntEquals(tc, 2, (int)maxFillsNeeded);
+    CuAssertDblEquals(tc, 0.0, getFillableShares(&book, SELL, 90, 7, &maxFillsNeeded), 0.0);
+
+    /**
+     * A fill-or-kill order which cannot be filled completely leaves the book untouched.
+     */
+    Order taker;
+    initDummyOrder(&taker, BUY, 102, 25);
+    CuAssertIntEquals(tc, 0, submitOrder(&book, &taker, ORDER_FOK, fills, 8, &fillCount));
+    CuAssertIntEquals(tc, 0, (int)fillCount);
+    CuAssertDblEquals(tc, 25.0, taker.shares, 0.0);
+    CuAssertDblEquals(tc, 10.0, getBestOffer(&book)->size, 0.0);
+    taker.limit = 104;
+    CuAssertIntEquals(tc, -1, submitOrder(&book, &taker, ORDER_FOK, fills, 2, &fillCount));
+    CuAssertDblEquals(tc, 25.0, taker.shares, 0.0);
+    CuAssertIntEquals(tc, 1, submitOrder(&book, &taker, ORDER_FOK, fills, 8, &fillCount));
+    CuAssertIntEquals(tc, 4, (int)fillCount);
+    CuAssertDblEquals(tc, 0.0, taker.shares, 0.0);
+    CuAssertDblEquals(tc, 104.0, getBestOffer(&book)->limitPrice, 0.0);
+    CuAssertDblEquals(tc, 5.0, getBestOffer(&book)->size, 0.0);
+
+    /**
+     * An immediate-or-cancel order fills what it can and never rests.
+     */
+    initDummyOrder(&taker, BUY, 104, 8);
+    CuAssertIntEquals(tc, 1, submitOrder(&book, &taker, ORDER_IOC, fills, 8, &fillCount));
+    CuAssertIntEquals(tc, 1, (int)fillCount);
+    CuAssertDblEquals(tc, 3.0, taker.shares, 0.0);
+    CuAssertPtrEquals(tc, NULL, taker.parentLimit);
+    CuAssertPtrEquals(tc, NULL, getBestBid(&book));
+    CuAssertPtrEquals(tc, NULL, getBestOffer(&book));
+
+    /**
+     * A market order trades at any price.
+     */
+    Order bids[2];
+    initDummyOrder(&bids[0], BUY, 90, 4);
+    initDummyOrder(&bids[1], BUY, 50, 4);
+    addOrder(&book, &bids[0]);
+    addOrder(&book, &bids[1]);
+    initDummyOrder(&taker, SELL, 1000, 6);
+    CuAssertIntEquals(tc, 1, submitOrder(&book, &taker, ORDER_MARKET, fills, 8, &fillCount));
+    CuAssertIntEquals(tc, 2, (int)fillCount);
+    CuAssertDblEquals(tc, 90.0, fills[0].price, 0.0);
+    CuAssertDblEquals(tc, 50.0, fills[1].price, 0.0);
+    CuAssertDblEquals(tc, 2.0, getBestBid(&book)->size, 0.0);
+    CuAssertPtrEquals(tc, NULL, getBestOffer(&book));
+
+    /**
+     * Unknown order types and sides are rejected without touching the book.
+     */
+    initDummyOrder(&taker, SELL, 10, 1);
+    CuAssertIntEquals(tc, 0, submitOrder(&book, &taker, 7, fills, 8, &fillCount));
+    CuAssertIntEquals(tc, 0, submitOrder(&book, &taker, -1, fills, 8, &fillCount));
+    taker.buyOrSell = 2;
+    CuAssertIntEquals(tc, 0, submitOrder(&book, &taker, ORDER_MARKET, fills, 8, &fillCount));
+    CuAssertIntEquals(tc, 0, (int)fillCount);
+    CuAssertDblEquals(tc, 1.0, taker.shares, 0.0);
+    CuAssertDblEquals(tc, 2.0, getBestBid(&book)->size, 0.0);
+
+    destroyBook(&book);
+}
+
+void
+TestLadderOffGridPrices(CuTest *tc){
+    /**
+     * A ladder book rejects orders between ticks instead of mixing them into a
+     * neighbouring tick's limit, and a NaN price does not leak a limit.
+     */
+    Book book;
+    initBook(&book);
+    CuAssertIntEquals(tc, 1, initLadders(&book, 5, 16));
+    Order orders[4];
+    initDummyOrder(&orders[0], BUY, 100, 1);
+    initDummyOrder(&orders[1], BUY, 102, 1);
+    initDummyOrder(&orders[2], BUY, 1002, 1);
+    CuAssertIntEquals(tc, 1, addOrder(&book, &orders[0]));
+    CuAssertIntEquals(tc, 0, addOrder(&book, &orders[1]));
+    CuAssertPtrEquals(tc, NULL, orders[1].parentLimit);
+    CuAssertIntEquals(tc, 0, addOrder(&book, &orders[2]));
+    CuAssertIntEquals(tc, 1, book.highestBuy->orderCount);
+#ifndef HFTLOB_FIXED_POINT
+    /* Rounding noise is snapped onto the grid. */
+    initDummyOrder(&orders[3], BUY, 100 + 1e-12, 1);
+    CuAssertIntEquals(tc, 1, addOrder(&book, &orders[3]));
+    CuAssertPtrEquals(tc, book.highestBuy, orders[3].parentLimit);
+    CuAssertTrue(tc, orders[3].limit == 100);
+    destroyBook(&book);
+
+    initBook(&book);
+    size_t limits = book.limitPool.count;
+    initDummyOrder(&orders[3], BUY, NAN, 1);
+    CuAssertIntEquals(tc, 0, addOrder(&book, &orders[3]));
+    CuAssertIntEquals(tc, limits, book.limitPool.count);
+#endif
+    destroyBook(&book);
+}
+
+void
+TestGetNextBookLimit(CuTest *tc){
+    /**
+     * Walking a side from its inside visits every limit once, in price order, whether
+     * the limits are in the tree or in the ladder and the tree behind it.
+     */
+    int ladder;
+    for(ladder=0; ladder<2; ladder++){
+        Book book;
+        initBook(&book);
+        if(ladder){
+            initLadders(&book, 1, 16);
+        }
+        Order orders[40];
+        int i;
+        for(i=0; i<40; i++){
+            initDummyOrder(&orders[i], i % 2 ? BUY : SELL, i % 2 ? 100 - (i * 7) % 41 : 101 + (i * 7) % 41, 1);
+            addOrder(&book, &orders[i]);
+        }
+        unsigned side;
+        for(side=0; side<2; side++){
+            Limit *limit = side == BUY ? getBestBid(&book) : getBestOffer(&book);
+            Limit *next;
+            int levels = 1;
+            while((next = getNextBookLimit(&book, limit, side)) != NULL){
+                CuAssertTrue(tc, side == BUY ? next->limitPrice < limit->limitPrice
+                                             : next->limitPrice > limit->limitPrice);
+                limit = next;
+                levels++;
+            }
+            CuAssertIntEquals(tc, 20, levels);
+        }
+        destroyBook(&book);
+    }
+}
+
+/**
+ * Test the batched event API.
+ */
+
+void
+TestApplyEvents(CuTest *tc){
+    /**
+     * Apply random adds, cancels, modifies and executions to one book in batches and to
+     * another one call at a time, and assert both books agree after every batch.
+     */
+    Book batchBook, singleBook;
+    initBook(&batchBook);
+    initBook(&singleBook);
+    reserveOrders(&batchBook, 256);
+    reserveOrders(&singleBook, 256);
+
+    int count = 64;
+    Order batchOrders[64], singleOrders[64];
+    Event events[32];
+    TopOfBook top;
+    int i, e, batch;
+    for(i=0; i<count; i++){
+        batchOrders[i].parentLimit = NULL;
+        singleOrders[i].parentLimit = NULL;
+    }
+    srand(11);
+    for(batch=0; batch<200; batch++){
+        /* Each order appears at most once per batch, as the batch book lags behind. */
+        char used[64] = {0};
+        for(e=0; e<31; e++){
+            Event *event = &events[e];
+            do{
+                i = rand() % count;
+            } while(used[i]);
+            used[i] = 1;
+            event->order = NULL;
+            event->id = i + 1;
+            if(singleOrders[i].parentLimit == NULL){
+                unsigned side = rand() % 2 ? BUY : SELL;
+                Price price = side == BUY ? 100 - rand() % 10 : 101 + rand() % 10;
+                initDummyOrder(&batchOrders[i], side, price, 1 + rand() % 9);
+                initDummyOrder(&singleOrders[i], side, price, batchOrders[i].shares);
+                batchOrders[i].id = singleOrders[i].id = i + 1;
+                event->type = EVENT_ADD;
+                event->order = &batchOrders[i];
+                addOrder(&singleBook, &singleOrders[i]);
+            }
+            else if(rand() % 3 == 0){
+                event->type = EVENT_CANCEL;
+                cancelOrder(&singleBook, &singleOrders[i]);
+            }
+            else if(rand() % 2 == 0){
+                event->type = EVENT_MODIFY;
+                event->price = singleOrders[i].limit + (rand() % 3 - 1);
+                event->shares = 1 + rand() % 9;
+                modifyOrder(&singleBook, &singleOrders[i], event->price, event->shares);
+            }
+            else{
+                event->type = EVENT_EXECUTE;
+                event->order = &batchOrders[i];
+                event->shares = 1 + rand() % 9;
+                executeOrderShares(&singleBook, &singleOrders[i], event->shares);
+            }
+        }
+        /* An unknown id fails without affecting the rest of the batch. */
+        events[31].type = EVENT_CANCEL;
+        events[31].order = NULL;
+        events[31].id = 1000;
+
+        CuAssertIntEquals(tc, 1, (int)applyEvents(&batchBook, events, 32, &top));
+        CuAssertIntEquals(tc, 0, events[31].result);
+        for(i=0; i<count; i++){
+            CuAssertTrue(tc, (singleOrders[i].parentLimit == NULL) == (batchOrders[i].parentLimit == NULL));
+            if(singleOrders[i].parentLimit != NULL){
+                CuAssertDblEquals(tc, singleOrders[i].limit, batchOrders[i].limit, 0.0);
+                CuAssertDblEquals(tc, singleOrders[i].shares, batchOrders[i].shares, 0.0);
+                CuAssertDblEquals(tc, singleOrders[i].parentLimit->size, batchOrders[i].parentLimit->size, 0.0);
+            }
+        }
+        TopOfBook expected;
+        getTopOfBook(&singleBook, &expected);
+        CuAssertDblEquals(tc, expected.bidPrice, top.bidPrice, 0.0);
+        CuAssertDblEquals(tc, expected.bidSize, top.bidSize, 0.0);
+        CuAssertIntEquals(tc, expected.bidOrders, top.bidOrders);
+        CuAssertDblEquals(tc, expected.askPrice, top.askPrice, 0.0);
+        CuAssertDblEquals(tc, expected.askSize, top.askSize, 0.0);
+        CuAssertIntEquals(tc, expected.askOrders, top.askOrders);
+    }
+
+    /* A pooled order added by pointer stays the caller's; one added by value is released. */
+    Order *pooled = allocateOrder(&batchBook);
+    initDummyOrder(pooled, BUY, 90, 1);
+    pooled->id = 500;
+    size_t pooledCount = batchBook.orderPool.count;
+    events[0].type = EVENT_ADD;
+    events[0].order = pooled;
+    events[1].type = EVENT_CANCEL;
+    events[1].order = NULL;
+    events[1].id = 500;
+    events[2].type = EVENT_ADD;
+    events[2].order = NULL;
+    events[2].id = 501;
+    events[2].buyOrSell = SELL;
+    events[2].price = 120;
+    events[2].shares = 2;
+    events[3] = events[1];
+    events[3].id = 501;
+    CuAssertIntEquals(tc, 0, (int)applyEvents(&batchBook, events, 4, NULL));
+    CuAssertIntEquals(tc, pooledCount, batchBook.orderPool.count);
+    CuAssertTrue(tc, pooled->id == 500);
+    releaseOrder(&batchBook, pooled);
+
+    destroyBook(&batchBook);
+    destroyBook(&singleBook);
+}
+
+/**
+ * Test the pools.
+ */
+
+void
+TestPool(CuTest *tc){
+    Pool pool;
+    CuAssertIntEquals(tc, 1, initPool(&pool, sizeof(Limit), 100, 0));
+    CuAssertIntEquals(tc, 128, (int)pool.slabObjects);
+    CuAssertIntEquals(tc, 1, (int)pool.slabCount);
+
+    /**
+     * Objects are distinct, and freed objects are handed out again first.
+     */
+    Limit *first = allocFromPool(&pool);
+    Limit *second = allocFromPool(&pool);
+    CuAssertTrue(tc, first != NULL && second != NULL && first != second);
+    CuAssertIntEquals(tc, 2, (int)pool.count);
+    freeToPool(&pool, first);
+    CuAssertPtrEquals(tc, first, allocFromPool(&pool));
+
+    /**
+     * A dry pool grows by another slab.
+     */
+    int i;
+    for(i=2; i<129; i++){
+        CuAssertTrue(tc, allocFromPool(&pool) != NULL);
+    }
+    CuAssertIntEquals(tc, 2, (int)pool.slabCount);
+    CuAssertIntEquals(tc, 129, (int)pool.count);
+    CuAssertIntEquals(tc, 256, (int)getPoolCapacity(&pool));
+    CuAssertIntEquals(tc, 1, (int)getPoolSlot(&pool, second));
+    for(i=129; i<257; i++){
+        allocFromPool(&pool);
+    }
+    CuAssertIntEquals(tc, 3, (int)pool.slabCount);
+    CuAssertIntEquals(tc, 512, (int)getPoolCapacity(&pool));
+    CuAssertIntEquals(tc, 256, (int)getPoolSlot(&pool, pool.slabs[2]));
+    CuAssertIntEquals(tc, 129, (int)getPoolSlot(&pool, (Limit*)pool.slabs[1] + 1));
+    CuAssertTrue(tc, (size_t)-1 == getPoolSlot(&pool, &pool));
+    CuAssertPtrEquals(tc, pool.slabs[2], getPoolObject(&pool, 256));
+    CuAssertPtrEquals(tc, (Limit*)pool.slabs[1] + 1, getPoolObject(&pool, 129));
+    CuAssertPtrEquals(tc, second, getPoolObject(&pool, 1));
+    destroyPool(&pool);
+
+    /**
+     * Huge page backed pools fall back to normal pages if none are reserved.
+     */
+    CuAssertIntEquals(tc, 1, initPool(&pool, sizeof(Order), 1000, POOL_HUGE_PAGES));
+    Order *order = allocFromPool(&pool);
+    initOrder(order);
+    CuAssertPtrEquals(tc, NULL, order->parentLimit);
+    freeToPool(&pool, order);
+    destroyPool(&pool);
+}
+
+void
+TestBookPools(CuTest *tc){
+    Book book;
+    initBook(&book);
+    CuAssertIntEquals(tc, 1, reservePools(&book, 64, 16, 0));
+    CuAssertIntEquals(tc, 2, (int)book.limitPool.count);
+
+    /**
+     * Limits are taken from and returned to the book's pool.
+     */
+    Order *orders[16];
+    int i;
+    for(i=0; i<16; i++){
+        orders[i] = allocateOrder(&book);
+        orders[i]->buyOrSell = i % 2 ? BUY : SELL;
+        orders[i]->limit = i % 2 ? 100 - i : 101 + i;
+        orders[i]->shares = 1;
+        CuAssertIntEquals(tc, 1, addOrder(&book, orders[i]));
+    }
+    CuAssertIntEquals(tc, 18, (int)book.limitPool.count);
+    CuAssertIntEquals(tc, 16, (int)book.orderPool.count);
+
+    /**
+     * Pooled orders each sit in one cache line, with their metadata in a separate table.
+     */
+    CuAssertTrue(tc, sizeof(Order) <= 64);
+    CuAssertIntEquals(tc, 0, (int)((uintptr_t)orders[3] % 64));
+    CuAssertIntEquals(tc, 64, (int)((char*)orders[1] - (char*)orders[0]));
+    OrderMeta *meta = getOrderMeta(&book, orders[3]);
+    CuAssertPtrNotNull(tc, meta);
+    CuAssertPtrEquals(tc, NULL, meta->tid);
+    meta->tid = "1234";
+    meta->exchangeId = 7;
+    CuAssertPtrEquals(tc, meta, getOrderMeta(&book, orders[3]));
+    CuAssertTrue(tc, meta != getOrderMeta(&book, orders[4]));
+    Order external;
+    initOrder(&external);
+    CuAssertPtrEquals(tc, NULL, getOrderMeta(&book, &external));
+    CuAssertIntEquals(tc, 1, (int)book.limitPool.slabCount);
+    for(i=0; i<8; i++){
+        CuAssertIntEquals(tc, 1, cancelOrder(&book, orders[i]));
+        releaseOrder(&book, orders[i]);
+    }
+    CuAssertIntEquals(tc, 10, (int)book.limitPool.count);
+    CuAssertIntEquals(tc, 8, (int)book.orderPool.count);
+
+    /**
+     * The pools can only be resized while the book is empty.
+     */
+    CuAssertIntEquals(tc, 0, reservePools(&book, 128, 0, 0));
+    for(i=8; i<16; i++){
+        CuAssertIntEquals(tc, 1, cancelOrder(&book, orders[i]));
+    }
+    CuAssertPtrEquals(tc, NULL, book.highestBuy);
+    CuAssertPtrEquals(tc, NULL, book.lowestSell);
+    /* An order still held outside the book would dangle. */
+    CuAssertIntEquals(tc, 0, reservePools(&book, 128, 0, 0));
+    for(i=8; i<16; i++){
+        releaseOrder(&book, orders[i]);
+    }
+    CuAssertIntEquals(tc, 1, reservePools(&book, 128, 0, 0));
+    CuAssertIntEquals(tc, 2, (int)book.limitPool.count);
+    CuAssertTrue(tc, getPoolCapacity(&book.limitPool) >= 130);
+    orders[0] = allocateOrder(&book);
+    initDummyOrder(orders[0], BUY, 100, 1);
+    CuAssertIntEquals(tc, 1, addOrder(&book, orders[0]));
+
+    /* The remaining orders are freed with the book. */
+    destroyBook(&book);
+}
+
+void
+TestOrderHandles(CuTest *tc){
+    Book book;
+    initBook(&book);
+
+    /**
+     * Handles resolve to their orders until the orders are released.
+     */
+    Order *first = allocateOrder(&book);
+    Order *second = allocateOrder(&book);
+    uint64_t firstHandle = getOrderHandle(&book, first);
+    uint64_t secondHandle = getOrderHandle(&book, second);
+    CuAssertTrue(tc, firstHandle != secondHandle);
+    CuAssertPtrEquals(tc, first, getOrderByHandle(&book, firstHandle));
+    CuAssertPtrEquals(tc, second, getOrderByHandle(&book, secondHandle));
+
+    releaseOrder(&book, first);
+    CuAssertPtrEquals(tc, NULL, getOrderByHandle(&book, firstHandle));
+    CuAssertPtrEquals(tc, second, getOrderByHandle(&book, secondHandle));
+
+    /**
+     * A stale handle does not resolve to a new order reusing the same memory.
+     */
+    Order *third = allocateOrder(&book);
+    CuAssertPtrEquals(tc, first, third);
+    CuAssertPtrEquals(tc, NULL, getOrderByHandle(&book, firstHandle));
+    CuAssertPtrEquals(tc, third, getOrderByHandle(&book, getOrderHandle(&book, third)));
+
+    /**
+     * Nor after the slot has been reused more often than an 8 bit generation could count.
+     */
+    int i;
+    for(i=0; i<300; i++){
+        releaseOrder(&book, third);
+        third = allocateOrder(&book);
+        CuAssertPtrEquals(tc, first, third);
+        CuAssertPtrEquals(tc, NULL, getOrderByHandle(&book, firstHandle));
+    }
+
+    /**
+     * Orders not from the book's pool have no handle, and unknown slots do not resolve.
+     */
+    Order external;
+    initOrder(&external);
+    CuAssertTrue(tc, INVALID_HANDLE == getOrderHandle(&book, &external));
+    CuAssertPtrEquals(tc, NULL, getOrderByHandle(&book, INVALID_HANDLE));
+    CuAssertPtrEquals(tc, NULL, getOrderByHandle(&book, 100000));
+
+    destroyBook(&book);
+}
+
+/**
+ * Test the ladder mode of the Book.
+ */
+
+void
+TestLadderBook(CuTest *tc){
+    Book book;
+    initBook(&book);
+    CuAssertIntEquals(tc, 1, initLadders(&book, 1, 16));
+    CuAssertIntEquals(tc, 16, (int)book.buyLadder->capacity);
+
+    /**
+     * Limits near the inside go into the ladder, limits beyond the window into the tree.
+     */
+    Order orders[4];
+    initDummyOrder(&orders[0], BUY, 100, 10);
+    initDummyOrder(&orders[1], BUY, 95, 20);
+    initDummyOrder(&orders[2], BUY, 50, 30);
+    initDummyOrder(&orders[3], BUY, 100, 40);
+    int i;
+    for(i=0; i<4; i++){
+        CuAssertIntEquals(tc, 1, addOrder(&book, &orders[i]));
+    }
+    CuAssertTrue(tc, ladderContains(book.buyLadder, orders[0].parentLimit));
+    CuAssertTrue(tc, ladderContains(book.buyLadder, orders[1].parentLimit));
+    CuAssertTrue(tc, !ladderContains(book.buyLadder, orders[2].parentLimit));
+    CuAssertPtrEquals(tc, findLimit(book.buyTree, 50), orders[2].parentLimit);
+    CuAssertPtrEquals(tc, orders[0].parentLimit, getBestBid(&book));
+    CuAssertDblEquals(tc, 50.0, getBestBid(&book)->size, 0.0);
+    CuAssertPtrEquals(tc, orders[1].parentLimit, findBookLimit(&book, BUY, 95));
+    CuAssertPtrEquals(tc, NULL, findBookLimit(&book, BUY, 96));
+
+    /**
+     * A new inside far above the window moves the window up; the limits left behind move into the tree.
+     */
+    Order jump;
+    initDummyOrder(&jump, BUY, 200, 5);
+    CuAssertIntEquals(tc, 1, addOrder(&book, &jump));
+    CuAssertPtrEquals(tc, jump.parentLimit, getBestBid(&book));
+    CuAssertTrue(tc, ladderContains(book.buyLadder, jump.parentLimit));
+    CuAssertTrue(tc, !ladderContains(book.buyLadder, orders[0].parentLimit));
+    CuAssertPtrEquals(tc, findLimit(book.buyTree, 100), orders[0].parentLimit);
+    CuAssertPtrEquals(tc, orders[0].parentLimit, orders[3].parentLimit);
+    CuAssertIntEquals(tc, 2, orders[0].parentLimit->orderCount);
+
+    /**
+     * Once the ladder empties, the inside moves to the tree and the window follows it down.
+     */
+    CuAssertIntEquals(tc, 1, cancelOrder(&book, &jump));
+    CuAssertDblEquals(tc, 100.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertTrue(tc, ladderContains(book.buyLadder, getBestBid(&book)));
+    CuAssertTrue(tc, ladderContains(book.buyLadder, orders[1].parentLimit));
+    CuAssertPtrEquals(tc, orders[0].parentLimit, getBestBid(&book));
+    CuAssertPtrEquals(tc, orders[0].parentLimit, orders[3].parentLimit);
+
+    CuAssertPtrEquals(tc, &orders[0], executeOrder(&book, BUY));
+    CuAssertPtrEquals(tc, &orders[3], executeOrder(&book, BUY));
+    CuAssertDblEquals(tc, 95.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertPtrEquals(tc, &orders[1], executeOrder(&book, BUY));
+    CuAssertDblEquals(tc, 50.0, getBestBid(&book)->limitPrice, 0.0);
+    CuAssertTrue(tc, ladderContains(book.buyLadder, getBestBid(&book)));
+    CuAssertPtrEquals(tc, &orders[2], executeOrder(&book, BUY));
+    CuAssertPtrEquals(tc, NULL, getBestBid(&book));
+    CuAssertIntEquals(tc, 0, (int)book.buyLadder->count);
+
+    destroyBook(&book);
+}
+
+void
+TestLadderBookMatchesTreeBook(CuTest *tc){
+    /**
+     * Apply the same random adds and cancels around a drifting price to a tree book and a
+     * ladder book, and assert both always agree on the inside and on every limit.
+     */
+    Book treeBook, ladderBook;
+    initBook(&treeBook);
+    initBook(&ladderBook);
+    initLadders(&ladderBook, 1, 32);
+
+    int count = 400;
+    Order *treeOrders = malloc(count * sizeof(Order));
+    Order *ladderOrders = malloc(count * sizeof(Order));
+    int i, step, price;
+    int mid = 1000;
+    for(i=0; i<count; i++){
+        treeOrders[i].parentLimit = NULL;
+        ladderOrders[i].parentLimit = NULL;
+    }
+    srand(42);
+    for(step=0; step<20000; step++){
+        i = rand() % count;
+        if(treeOrders[i].parentLimit != NULL){
+            CuAssertIntEquals(tc, 1, cancelOrder(&treeBook, &treeOrders[i]));
+            CuAssertIntEquals(tc, 1, cancelOrder(&ladderBook, &ladderOrders[i]));
+        }
+        else{
+            mid += rand() % 5 - 2;
+            unsigned side = rand() % 2 ? BUY : SELL;
+            price = side == BUY ? mid - rand() % 60 : mid + 1 + rand() % 60;
+            initDummyOrder(&treeOrders[i], side, price, 1 + rand() % 9);
+            initDummyOrder(&ladderOrders[i], side, price, treeOrders[i].shares);
+            addOrder(&treeBook, &treeOrders[i]);
+            addOrder(&ladderBook, &ladderOrders[i]);
+        }
+
+        if(getBestBid(&treeBook) == NULL){
+            CuAssertPtrEquals(tc, NULL, getBestBid(&ladderBook));
+        }
+        else{
+            CuAssertDblEquals(tc, getBestBid(&treeBook)->limitPrice, getBestBid(&ladderBook)->limitPrice, 0.0);
+            CuAssertDblEquals(tc, getBestBid(&treeBook)->size, getBestBid(&ladderBook)->size, 0.0);
+        }
+        if(getBestOffer(&treeBook) == NULL){
+            CuAssertPtrEquals(tc, NULL, getBestOffer(&ladderBook));
+        }
+        else{
+            CuAssertDblEquals(tc, getBestOffer(&treeBook)->limitPrice, getBestOffer(&ladderBook)->limitPrice, 0.0);
+            CuAssertDblEquals(tc, getBestOffer(&treeBook)->size, getBestOffer(&ladderBook)->size, 0.0);
+        }
+    }
+    for(i=0; i<count; i++){
+        if(treeOrders[i].parentLimit != NULL){
+            Limit *limit = findBookLimit(&ladderBook, treeOrders[i].buyOrSell, treeOrders[i].limit);
+            CuAssertPtrEquals(tc, limit, ladderOrders[i].parentLimit);
+            CuAssertDblEquals(tc, treeOrders[i].parentLimit->size, limit->size, 0.0);
+            CuAssertIntEquals(tc, treeOrders[i].parentLimit->orderCount, limit->orderCount);
+        }
+    }
+
+    destroyBook(&treeBook);
+    destroyBook(&ladderBook);
+    free(treeOrders);
+    free(ladderOrders);
+}
+
+void
+TestBookSizeBetween(CuTest *tc){
+    /**
+     * Apply random adds, cancels and partial executions to a tree book and a ladder book,
+     * and assert the subtree totals stay exact and range queries on both books match the
+     * sum over the resting orders. The ladder book keeps no subtree totals for the first
+     * half, and rebuilds them when it starts to.
+     */
+    Book treeBook, ladderBook;
+    initBook(&treeBook);
+    initBook(&ladderBook);
+    enableRangeTotals(&treeBook);
+    initLadders(&ladderBook, 1, 32);
+
+    int count = 300;
+    Order *treeOrders = malloc(count * sizeof(Order));
+    Order *ladderOrders = malloc(count * sizeof(Order));
+    int i, step;
+    int mid = 1000;
+    for(i=0; i<count; i++){
+        treeOrders[i].parentLimit = NULL;
+        ladderOrders[i].parentLimit = NULL;
+    }
+    srand(7);
+    for(step=0; step<5000; step++){
+        i = rand() % count;
+        if(treeOrders[i].parentLimit != NULL && treeOrders[i].shares > 1 && rand() % 2){
+            executeOrderShares(&treeBook, &treeOrders[i], 1);
+            executeOrderShares(&ladderBook, &ladderOrders[i], 1);
+        }
+        else if(treeOrders[i].parentLimit != NULL){
+            cancelOrder(&treeBook, &treeOrders[i]);
+            cancelOrder(&ladderBook, &ladderOrders[i]);
+        }
+        else{
+            mid += rand() % 5 - 2;
+            unsigned side = rand() % 2 ? BUY : SELL;
+            Price price = side == BUY ? mid - rand() % 60 : mid + 1 + rand() % 60;
+            initDummyOrder(&treeOrders[i], side, price, 1 + rand() % 9);
+            initDummyOrder(&ladderOrders[i], side, price, treeOrders[i].shares);
+            addOrder(&treeBook, &treeOrders[i]);
+            addOrder(&ladderBook, &ladderOrders[i]);
+        }
+        if(step == 2500){
+            enableRangeTotals(&ladderBook);
+        }
+        if(step % 50 != 0){
+            continue;
+        }
+        checkSubtreeTotals(tc, treeBook.buyTree->rightChild);
+        checkSubtreeTotals(tc, treeBook.sellTree->rightChild);
+        if(ladderBook.rangeTotals){
+            checkSubtreeTotals(tc, ladderBook.buyTree->rightChild);
+            checkSubtreeTotals(tc, ladderBook.sellTree->rightChild);
+        }
+        checkInOrderLinks(tc, treeBook.buyTree);
+        checkInOrderLinks(tc, treeBook.sellTree);
+
+        unsigned side = rand() % 2 ? BUY : SELL;
+        Price low = mid - 70 + rand() % 70;
+        Price high = low + rand() % 70;
+        Quantity expectedSize = 0;
+        Volume expectedVolume = 0;
+        int j;
+        for(j=0; j<count; j++){
+            if(treeOrders[j].parentLimit != NULL && treeOrders[j].buyOrSell == side
+               && treeOrders[j].limit >= low && treeOrders[j].limit <= high){
+                expectedSize += treeOrders[j].shares;
+                expectedVolume += treeOrders[j].shares * treeOrders[j].limit;
+            }
+        }
+        Volume volume;
+        CuAssertDblEquals(tc, expectedSize, getBookSizeBetween(&treeBook, side, low, high, &volume), 0.0);
+        CuAssertDblEquals(tc, expectedVolume, volume, 0.0);
+        CuAssertDblEquals(tc, expectedSize, getBookSizeBetween(&ladderBook, side, low, high, &volume), 0.0);
+        CuAssertDblEquals(tc, expectedVolume, volume, 0.0);
+    }
+    CuAssertDblEquals(tc, 0, getBookSizeBetween(&treeBook, BUY, 10, 5, NULL), 0.0);
+
+    /* Infinite, huge and off-grid bounds cover exactly the ticks inside them. */
+#ifdef HFTLOB_FIXED_POINT
+    Price bounds[][2] = {{MIN_PRICE, MAX_PRICE}, {0, MAX_PRICE}};
+#else
+    Price bounds[][2] = {{MIN_PRICE, MAX_PRICE}, {0, 1e30},
+                         {mid - 30 + 0.4, mid + 30 - 0.4}, {mid - 30.6, mid + 30.6}};
+#endif
+    int b;
+    for(b=0; b<(int)(sizeof(bounds) / sizeof(bounds[0])); b++){
+        unsigned side;
+        for(side=0; side<2; side++){
+            Quantity expectedSize = 0;
+            int j;
+            for(j=0; j<count; j++){
+                if(treeOrders[j].parentLimit != NULL && treeOrders[j].buyOrSell == side
+                   && treeOrders[j].limit >= bounds[b][0] && treeOrders[j].limit <= bounds[b][1]){
+                    expectedSize += treeOrders[j].shares;
+                }
+            }
+            CuAssertTrue(tc, expectedSize > 0);
+            CuAssertDblEquals(tc, expectedSize, getBookSizeBetween(&treeBook, side, bounds[b][0], bounds[b][1], NULL), 0.0);
+            CuAssertDblEquals(tc, expectedSize, getBookSizeBetween(&ladderBook, side, bounds[b][0], bounds[b][1], NULL), 0.0);
+        }
+    }
+
+    destroyBook(&treeBook);
+    destroyBook(&ladderBook);
+    free(treeOrders);
+    free(ladderOrders);
+}
+
+void
+TestQueuePosition(CuTest *tc){
+    /**
+     * Apply random adds, cancels, partial executions and fills at a handful of prices, and
+     * assert every order's queue position matches a walk to the tail of its limit.
+     */
+    Book book;
+    initBook(&book);
+    int count = 200;
+    Order *orders = malloc(count * sizeof(Order));
+    Quantity sharesAhead;
+    int ordersAhead;
+    int i, j, step;
+    for(i=0; i<count; i++){
+        initOrder(&orders[i]);
+    }
+    CuAssertIntEquals(tc, 0, getQueuePosition(&orders[0], &sharesAhead, &ordersAhead));
+
+    srand(11);
+    for(step=0; step<4000; step++){
+        i = rand() % count;
+        if(orders[i].parentLimit != NULL && orders[i].shares > 1 && rand() % 2){
+            executeOrderShares(&book, &orders[i], 1 + rand() % (int)(orders[i].shares - 1));
+        }
+        else if(orders[i].parentLimit != NULL){
+            cancelOrder(&book, &orders[i]);
+        }
+        else if(rand() % 8 == 0 && getBestBid(&book) != NULL){
+            executeOrder(&book, BUY);
+        }
+        else{
+            initDummyOrder(&orders[i], BUY, 100 - rand() % 4, 1 + rand() % 9);
+            addOrder(&book, &orders[i]);
+        }
+        if(step % 10 != 0){
+            continue;
+        }
+        for(j=0; j<count; j++){
+            if(orders[j].parentLimit == NULL){
+                continue;
+            }
+            Quantity expectedShares = 0;
+            int expectedOrders = 0;
+            Order *older;
+            for(older=orders[j].nextOrder; older!=NULL; older=older->nextOrder){
+                expectedShares += older->shares;
+                expectedOrders++;
+            }
+            CuAssertIntEquals(tc, 1, getQueuePosition(&orders[j], &sharesAhead, &ordersAhead));
+            CuAssertDblEquals(tc, expectedShares, sharesAhead, 0.0);
+            CuAssertIntEquals(tc, expectedOrders, ordersAhead);
+        }
+    }
+
+    destroyBook(&book);
+    free(orders);
+}
+
+void
+TestBookDepth(CuTest *tc){
+    /**
+     * Apply random adds, cancels, modifies, partial executions and crossing orders to a
+     * tree book and a ladder book, and assert the kept depth always matches a walk of the
+     * best levels of each side.
+     */
+    int ladder;
+    for(ladder=0; ladder<2; ladder++){
+        Book book;
+        initBook(&book);
+        if(ladder){
+            initLadders(&book, 1, 16);
+        }
+        int count = 200;
+        Order *orders = malloc(count * sizeof(Order));
+        Fill fills[64];
+        DepthLevel levels[5];
+        size_t fillCount;
+        int i, step, mid = 1000;
+        for(i=0; i<count; i++){
+            initOrder(&orders[i]);
+        }
+        srand(13);
+        for(step=0; step<4000; step++){
+            if(step == 100){
+                CuAssertIntEquals(tc, 1, initBookDepth(&book, 5));
+            }
+            i = rand() % count;
+            if(orders[i].parentLimit != NULL){
+                switch(rand() % 3){
+                    case 0:
+                        cancelOrder(&book, &orders[i]);
+                        break;
+                    case 1:
+                        modifyOrder(&book, &orders[i], orders[i].limit + (orders[i].buyOrSell == BUY ? -1 : 1) * (rand() % 3), 1 + rand() % 9);
+                        break;
+                    default:
+                        executeOrderShares(&book, &orders[i], 1 + rand() % 3);
+                }
+            }
+            else{
+                mid += rand() % 3 - 1;
+                unsigned side = rand() % 2 ? BUY : SELL;
+                Price price = side == BUY ? mid - rand() % 12 : mid + 1 + rand() % 12;
+                if(rand() % 10 == 0){
+                    price += side == BUY ? 4 : -4;
+                }
+                initDummyOrder(&orders[i], side, price, 1 + rand() % 9);
+                submitOrder(&book, &orders[i], ORDER_LIMIT, fills, 64, &fillCount);
+            }
+            if(step < 100){
+                continue;
+            }
+            unsigned side;
+            for(side=0; side<2; side++){
+                int levelCount = copyBookDepth(&book, side, levels, 5);
+                Limit *limit = side == BUY ? getBestBid(&book) : getBestOffer(&book);
+                int j;
+                for(j=0; j<levelCount; j++){
+                    CuAssertPtrNotNull(tc, limit);
+                    CuAssertDblEquals(tc, limit->limitPrice, levels[j].price, 0.0);
+                    CuAssertDblEquals(tc, limit->size, levels[j].size, 0.0);
+                    CuAssertIntEquals(tc, limit->orderCount, levels[j].orders);
+                    limit = getNextBookLimit(&book, limit, side);
+                }
+                CuAssertTrue(tc, levelCount == 5 || limit == NULL);
+            }
+        }
+        destroyBook(&book);
+        free(orders);
+    }
+}
+
+void
+TestBookRegistry(CuTest *tc){
+    /**
+     * Route events of several instruments through a registry, and assert each lands in its
+     * own book, that lazy books are created by their first add only, and that events of
+     * unknown instruments fail.
+     */
+    BookRegistry registry;
+    CuAssertIntEquals(tc, 1, initBookRegistry(&registry, 100));
+    CuAssertIntEquals(tc, 1, registerInstrument(&registry, 3, 0.01, 1, &ACTIVE_TIER));
+    CuAssertIntEquals(tc, 1, registerInstrument(&registry, 42, 0.05, 100, &ILLIQUID_TIER));
+    CuAssertIntEquals(tc, 0, registerInstrument(&registry, 42, 0.05, 100, &ILLIQUID_TIER));
+    CuAssertIntEquals(tc, 0, registerInstrument(&registry, 100, 0.01, 1, &ACTIVE_TIER));
+    CuAssertIntEquals(tc, 1, registerInstrument(&registry, 5, 0.01, 1, NULL));
+    CuAssertPtrEquals(tc, (void*)&ILLIQUID_TIER, (void*)registry.entries[5].tier);
+    CuAssertIntEquals(tc, 1, registry.bookCount);
+    CuAssertPtrNotNull(tc, getInstrumentBook(&registry, 3, 0));
+    CuAssertPtrEquals(tc, NULL, getInstrumentBook(&registry, 42, 0));
+    CuAssertPtrEquals(tc, NULL, getInstrumentBook(&registry, 7, 1));
+
+    Order orders[4];
+    initDummyOrder(&orders[0], BUY, 100, 10);
+    initDummyOrder(&orders[1], SELL, 101, 5);
+    initDummyOrder(&orders[2], BUY, 100, 7);
+    initDummyOrder(&orders[3], SELL, 102, 1);
+    int i;
+    for(i=0; i<4; i++){
+        orders[i].id = i + 1;
+    }
+    Event events[7];
+    uint32_t instruments[7] = {42, 3, 3, 42, 7, 3, 42};
+    int types[7] = {EVENT_CANCEL, EVENT_ADD, EVENT_ADD, EVENT_ADD, EVENT_ADD, EVENT_CANCEL, EVENT_ADD};
+    Order *eventOrders[7] = {NULL, &orders[0], &orders[1], &orders[2], &orders[3], NULL, &orders[3]};
+    for(i=0; i<7; i++){
+        events[i].type = types[i];
+        events[i].instrument = instruments[i];
+        events[i].order = eventOrders[i];
+        events[i].id = 2;
+    }
+    /* Cancelling before the lazy book exists, and adding to an unknown instrument fail. */
+    CuAssertIntEquals(tc, 2, dispatchEvents(&registry, events, 7));
+    CuAssertIntEquals(tc, 0, events[0].result);
+    CuAssertIntEquals(tc, 0, events[4].result);
+    CuAssertIntEquals(tc, 1, events[5].result);
+    CuAssertIntEquals(tc, 2, registry.bookCount);
+
+    Book *active = getInstrumentBook(&registry, 3, 0);
+    Book *illiquid = getInstrumentBook(&registry, 42, 0);
+    CuAssertPtrNotNull(tc, illiquid);
+    CuAssertPtrNotNull(tc, active->buyLadder);
+    CuAssertPtrEquals(tc, NULL, illiquid->buyLadder);
+    /* The illiquid book's pools are grown on demand, and it only holds external orders. */
+    CuAssertIntEquals(tc, 0, (int)illiquid->orderPool.slabCount);
+    CuAssertIntEquals(tc, 1, (int)illiquid->limitPool.slabCount);
+    CuAssertPtrEquals(tc, orders[0].parentLimit, getBestBid(active));
+    CuAssertPtrEquals(tc, NULL, getBestOffer(active));
+    CuAssertPtrEquals(tc, orders[2].parentLimit, getBestBid(illiquid));
+    CuAssertPtrEquals(tc, orders[3].parentLimit, getBestOffer(illiquid));
+    CuAssertPtrEquals(tc, &orders[3], getOrderById(illiquid, 4));
+
+    destroyBookRegistry(&registry);
+}
+
+void
+TestSpscRing(CuTest *tc){
+    /**
+     * A ring hands events over in order, refuses pushes when full and pops at most the
+     * requested number of events.
+     */
+    SpscRing ring;
+    Event event, events[8];
+    int i;
+    CuAssertIntEquals(tc, 1, initSpscRing(&ring, 5));
+    for(i=0; i<8; i++){
+        event.id = i;
+        CuAssertIntEquals(tc, 1, pushToSpscRing(&ring, &event));
+    }
+    CuAssertIntEquals(tc, 0, pushToSpscRing(&ring, &event));
+    CuAssertIntEquals(tc, 3, popFromSpscRing(&ring, events, 3));
+    CuAssertIntEquals(tc, 2, events[2].id);
+    for(i=8; i<11; i++){
+        event.id = i;
+        CuAssertIntEquals(tc, 1, pushToSpscRing(&ring, &event));
+    }
+    /* The consumer only looks for new events once it has run out of known ones. */
+    CuAssertIntEquals(tc, 5, popFromSpscRing(&ring, events, 8));
+    CuAssertIntEquals(tc, 3, popFromSpscRing(&ring, events + 5, 8));
+    for(i=0; i<8; i++){
+        CuAssertIntEquals(tc, i + 3, events[i].id);
+    }
+    CuAssertIntEquals(tc, 0, popFromSpscRing(&ring, events, 8));
+    destroySpscRing(&ring);
+}
+
+void
+TestEngine(CuTest *tc){
+    /**
+     * Feed adds and cancels for several instruments through a small ring to three workers,
+     * and assert every book ends up with exactly the orders left standing.
+     */
+    int instruments = 7;
+    int perInstrument = 300;
+    int i, j, round;
+    EngineConfig config;
+    Engine engine;
+    initEngineConfig(&config);
+    config.workerCount = 3;
+    config.ringCapacity = 16;
+    config.batchSize = 4;
+    CuAssertIntEquals(tc, 1, initEngine(&engine, &config, instruments));
+    for(i=0; i<instruments; i++){
+        CuAssertIntEquals(tc, 1, registerEngineInstrument(&engine, i, 1, 1, i % 2 ? &ILLIQUID_TIER : &ACTIVE_TIER));
+    }
+    Order *orders = malloc(instruments * perInstrument * sizeof(Order));
+    for(i=0; i<instruments * perInstrument; i++){
+        initDummyOrder(&orders[i], i % 2 ? BUY : SELL, i % 2 ? 1000 - i % 50 : 1001 + i % 50, 1 + i % 7);
+        orders[i].id = i + 1;
+    }
+    CuAssertIntEquals(tc, 1, startEngine(&engine));
+    CuAssertIntEquals(tc, 0, registerEngineInstrument(&engine, 6, 1, 1, &ACTIVE_TIER));
+
+    /* Orders cannot be shared with the workers. */
+    Event event;
+    event.type = EVENT_ADD;
+    event.instrument = 0;
+    event.order = &orders[0];
+    CuAssertIntEquals(tc, -1, submitEngineEvent(&engine, &event));
+
+    /* Add all orders by value, then cancel every third one; the last round is not cancelled. */
+    uint64_t submitted = 0;
+    for(round=0; round<2; round++){
+        for(j=0; j<perInstrument; j++){
+            for(i=0; i<instruments; i++){
+                Order *order = &orders[i * perInstrument + j];
+                if(round == 1 && j % 3 != 0){
+                    continue;
+                }
+                event.type = round == 0 ? EVENT_ADD : EVENT_CANCEL;
+                event.instrument = i;
+                event.order = NULL;
+                event.id = order->id;
+                event.buyOrSell = order->buyOrSell;
+                event.price = order->limit;
+                event.shares = order->shares;
+                while(!submitEngineEvent(&engine, &event)){
+                }
+                submitted++;
+            }
+        }
+    }
+    stopEngine(&engine);
+
+    uint64_t processed = 0;
+    for(i=0; i<config.workerCount; i++){
+        processed += engine.workers[i].processed;
+        CuAssertIntEquals(tc, 0, (int)engine.workers[i].failed);
+    }
+    CuAssertTrue(tc, processed == submitted);
+    for(i=0; i<instruments; i++){
+        Book *book = getEngineBook(&engine, i);
+        Quantity expected[2] = {0, 0};
+        for(j=0; j<perInstrument; j++){
+            Order *order = &orders[i * perInstrument + j];
+            if(j % 3 != 0){
+                expected[order->buyOrSell] += order->shares;
+                CuAssertPtrNotNull(tc, getOrderById(book, order->id));
+            }
+            else{
+                CuAssertPtrEquals(tc, NULL, getOrderById(book, order->id));
+            }
+        }
+        /* Cancelled orders went back to the pool. */
+        CuAssertIntEquals(tc, perInstrument - (perInstrument + 2) / 3, (int)book->orderPool.count);
+        CuAssertDblEquals(tc, expected[BUY], getBookSizeBetween(book, BUY, 0, 2000, NULL), 0.0);
+        CuAssertDblEquals(tc, expected[SELL], getBookSizeBetween(book, SELL, 0, 2000, NULL), 0.0);
+    }
+    destroyEngine(&engine);
+    free(orders);
+}
+
+/**
+ * Assert that a snapshot read from a book whose orders all have one share
+ * is internally consistent, which a torn copy would hardly be.
+ */
+void
+checkSnapshotData(CuTest *tc, BookSnapshotData *data){
+    int i;
+    CuAssertTrue(tc, data->bidLevels >= 0 && data->bidLevels <= SNAPSHOT_LEVELS);
+    CuAssertTrue(tc, data->askLevels >= 0 && data->askLevels <= SNAPSHOT_LEVELS);
+    if(data->bidLevels > 0){
+        CuAssertDblEquals(tc, data->bids[0].price, data->top.bidPrice, 0.0);
+        CuAssertDblEquals(tc, data->bids[0].size, data->top.bidSize, 0.0);
+    }
+    for(i=0; i<data->bidLevels; i++){
+        CuAssertDblEquals(tc, data->bids[i].orders, data->bids[i].size, 0.0);
+        CuAssertTrue(tc, i == 0 || data->bids[i].price < data->bids[i-1].price);
+    }
+    for(i=0; i<data->askLevels; i++){
+        CuAssertDblEquals(tc, data->asks[i].orders, data->asks[i].size, 0.0);
+        CuAssertTrue(tc, i == 0 || data->asks[i].price > data->asks[i-1].price);
+    }
+}
+
+typedef struct SnapshotReader{
+    BookSnapshot *snapshot;
+    atomic_int *done;
+    CuTest *tc;
+    long reads;
+} SnapshotReader;
+
+void*
+runSnapshotReader(void *arg){
+    SnapshotReader *reader = arg;
+    BookSnapshotData data;
+    while(!atomic_load(reader->done)){
+        readBookSnapshot(reader->snapshot, &data);
+        checkSnapshotData(reader->tc, &data);
+        reader->reads++;
+    }
+    return NULL;
+}
+
+void
+TestBookSnapshot(CuTest *tc){
+    /**
+     * Change a book with random adds and cancels while another thread reads its snapshot,
+     * and assert every read is consistent and the final snapshot matches the book.
+     */
+    Book book;
+    BookSnapshot snapshot;
+    BookSnapshotData data;
+    atomic_int done;
+    int count = 400;
+    Order *orders = malloc(count * sizeof(Order));
+    int i, step, mid = 1000;
+    initBook(&book);
+    initBookSnapshot(&snapshot);
+    for(i=0; i<count; i++){
+        initOrder(&orders[i]);
+    }
+    attachBookSnapshot(&book, &snapshot);
+    readBookSnapshot(&snapshot, &data);
+    CuAssertIntEquals(tc, 0, data.bidLevels);
+    CuAssertTrue(tc, data.top.askPrice == MAX_PRICE);
+
+    atomic_init(&done, 0);
+    SnapshotReader reader = {&snapshot, &done, tc, 0};
+    pthread_t thread;
+    CuAssertIntEquals(tc, 0, pthread_create(&thread, NULL, runSnapshotReader, &reader));
+    srand(17);
+    for(step=0; step<20000; step++){
+        i = rand() % count;
+        if(orders[i].parentLimit != NULL){
+            cancelOrder(&book, &orders[i]);
+        }
+        else{
+            mid += rand() % 3 - 1;
+            unsigned side = rand() % 2 ? BUY : SELL;
+            initDummyOrder(&orders[i], side, side == BUY ? mid - rand() % 20 : mid + 1 + rand() % 20, 1);
+            addOrder(&book, &orders[i]);
+        }
+    }
+    atomic_store(&done, 1);
+    pthread_join(thread, NULL);
+
+    /* Moving the inside order to another price publishes once, not for the cancel and add. */
+    Order *inside = getBestBid(&book)->headOrder;
+    unsigned sequence = atomic_load(&snapshot.sequence);
+    CuAssertIntEquals(tc, 1, modifyOrder(&book, inside, inside->limit - 1, 1));
+    CuAssertIntEquals(tc, sequence + 2, atomic_load(&snapshot.sequence));
+
+    readBookSnapshot(&snapshot, &data);
+    checkSnapshotData(tc, &data);
+    TopOfBook top;
+    getTopOfBook(&book, &top);
+    CuAssertTrue(tc, top.bidPrice == data.top.bidPrice);
+    CuAssertDblEquals(tc, top.askSize, data.top.askSize, 0.0);
+    Limit *limit = getBestOffer(&book);
+    for(i=0; i<data.askLevels; i++){
+        CuAssertDblEquals(tc, limit->limitPrice, data.asks[i].price, 0.0);
+        CuAssertIntEquals(tc, limit->orderCount, data.asks[i].orders);
+        limit = getNextBookLimit(&book, limit, SELL);
+    }
+    CuAssertTrue(tc, data.askLevels == SNAPSHOT_LEVELS || limit == NULL);
+    destroyBook(&book);
+    free(orders);
+}
+
+typedef struct DepthReader{
+    Book *book;
+    EpochDomain *domain;
+    atomic_int *done;
+    int failures;
+    long walks;
+} DepthReader;
+
+void*
+runDepthReader(void *arg){
+    /**
+     * Walk both sides of the book in read sections, counting any limit out
+     * of price order or order at the wrong price, which a limit or order
+     * reclaimed under the reader would show.
+     */
+    DepthReader *reader = arg;
+    int slot = registerEpochReader(reader->domain);
+    while(!atomic_load(reader->done)){
+        unsigned side;
+        enterEpoch(reader->domain, slot);
+        for(side=0; side<2; side++){
+            Limit *limit;
+            DepthLevel level, previous;
+            int first = 1;
+            for(limit=getFirstReadLimit(reader->book, side); limit!=NULL; limit=getNextReadLimit(limit, side)){
+                readLimitLevel(limit, &level);
+                if(!first && (side == BUY ? level.price >= previous.price : level.price <= previous.price)){
+                    reader->failures++;
+                }
+                Order *order;
+                for(order=getFirstReadOrder(limit); order!=NULL; order=getNextReadOrder(order)){
+                    Price price;
+                    __atomic_load(&order->limit, &price, __ATOMIC_RELAXED);
+                    if(price != level.price){
+                        reader->failures++;
+                    }
+                }
+                previous = level;
+                first = 0;
+            }
+        }
+        leaveEpoch(reader->domain, slot);
+        reader->walks++;
+    }
+    unregisterEpochReader(reader->domain, slot);
+    return NULL;
+}
+
+void
+TestEpochReclamation(CuTest *tc){
+    /**
+     * Removed limits and released orders are only reclaimed once no reader can see them,
+     * and readers walking the book while it changes never run into reclaimed ones.
+     */
+    Book book;
+    EpochDomain domain;
+    Order *orders[400];
+    int i, step, mid = 1000;
+    initBook(&book);
+    initEpochDomain(&domain);
+    CuAssertIntEquals(tc, 1, attachEpochDomain(&book, &domain));
+    CuAssertIntEquals(tc, 0, initLadders(&book, 1, 32));
+
+    /* Ladder slots are reused in place, so ladder books cannot have a domain attached. */
+    Book ladderBook;
+    initBook(&ladderBook);
+    CuAssertIntEquals(tc, 1, initLadders(&ladderBook, 1, 32));
+    CuAssertIntEquals(tc, 0, attachEpochDomain(&ladderBook, &domain));
+    CuAssertPtrEquals(tc, NULL, ladderBook.epochs);
+    destroyBook(&ladderBook);
+
+    int reader = registerEpochReader(&domain);
+    CuAssertTrue(tc, reader >= 0);
+    for(i=0; i<10; i++){
+        orders[i] = allocateOrder(&book);
+        initDummyOrder(orders[i], BUY, 100 + i, 1);
+        addOrder(&book, orders[i]);
+    }
+    size_t limits = book.limitPool.count;
+    enterEpoch(&domain, reader);
+    for(i=0; i<10; i++){
+        cancelOrder(&book, orders[i]);
+        releaseOrder(&book, orders[i]);
+    }
+    /* The reader holds back everything retired since it entered. */
+    CuAssertIntEquals(tc, 1, tryAdvanceEpoch(&domain));
+    CuAssertIntEquals(tc, 0, tryAdvanceEpoch(&domain));
+    CuAssertIntEquals(tc, limits, book.limitPool.count);
+    CuAssertIntEquals(tc, 10, book.orderPool.count);
+    leaveEpoch(&domain, reader);
+    CuAssertIntEquals(tc, 1, tryAdvanceEpoch(&domain));
+    CuAssertIntEquals(tc, 1, tryAdvanceEpoch(&domain));
+    CuAssertIntEquals(tc, limits - 10, book.limitPool.count);
+    CuAssertIntEquals(tc, 0, book.orderPool.count);
+    unregisterEpochReader(&domain, reader);
+
+    atomic_int done;
+    atomic_init(&done, 0);
+    DepthReader readers[2];
+    pthread_t threads[2];
+    for(i=0; i<2; i++){
+        readers[i].book = &book;
+        readers[i].domain = &domain;
+        readers[i].done = &done;
+        readers[i].failures = 0;
+        readers[i].walks = 0;
+        CuAssertIntEquals(tc, 0, pthread_create(&threads[i], NULL, runDepthReader, &readers[i]));
+    }
+    for(i=0; i<400; i++){
+        orders[i] = NULL;
+    }
+    CuAssertIntEquals(tc, 1, reserveOrders(&book, 400));
+
+    /* Moving an order to another price leaves the order readers may stand on alone. */
+    Order *moved = allocateOrder(&book);
+    initDummyOrder(moved, BUY, 100, 1);
+    moved->id = 7;
+    CuAssertIntEquals(tc, 1, addOrder(&book, moved));
+    orders[0] = allocateOrder(&book);
+    initDummyOrder(orders[0], BUY, 100, 1);
+    orders[0]->id = 8;
+    CuAssertIntEquals(tc, 1, addOrder(&book, orders[0]));
+    getOrderMeta(&book, orders[0])->exchangeId = 3;
+    CuAssertIntEquals(tc, 1, modifyOrder(&book, orders[0], 99, 2));
+    CuAssertPtrEquals(tc, NULL, orders[0]->parentLimit);
+    CuAssertPtrEquals(tc, moved, orders[0]->nextOrder);
+    CuAssertTrue(tc, orders[0]->limit == 100);
+    Order *fresh = getOrderById(&book, 8);
+    CuAssertTrue(tc, fresh != orders[0]);
+    CuAssertTrue(tc, fresh->limit == 99 && fresh->shares == 2);
+    CuAssertPtrEquals(tc, fresh, findBookLimit(&book, BUY, 99)->headOrder);
+    CuAssertIntEquals(tc, 3, getOrderMeta(&book, fresh)->exchangeId);
+    releaseOrder(&book, orders[0]);
+    orders[0] = fresh;
+    orders[1] = moved;
+
+    srand(19);
+    for(step=0; step<50000; step++){
+        i = rand() % 400;
+        if(orders[i] != NULL && rand() % 4 == 0){
+            Order *order = orders[i];
+            Price price = order->limit + (order->buyOrSell == BUY ? -1 : 1) * (rand() % 3 + 1);
+            CuAssertIntEquals(tc, 1, modifyOrder(&book, order, price, 1));
+            orders[i] = getOrderById(&book, order->id);
+            releaseOrder(&book, order);
+        }
+        else if(orders[i] != NULL){
+            cancelOrder(&book, orders[i]);
+            releaseOrder(&book, orders[i]);
+            orders[i] = NULL;
+        }
+        else{
+            mid += rand() % 3 - 1;
+            unsigned side = rand() % 2 ? BUY : SELL;
+            orders[i] = allocateOrder(&book);
+            initDummyOrder(orders[i], side, side == BUY ? mid - rand() % 30 : mid + 1 + rand() % 30, 1);
+            orders[i]->id = step + 100;
+            addOrder(&book, orders[i]);
+        }
+    }
+    atomic_store(&done, 1);
+    for(i=0; i<2; i++){
+        pthread_join(threads[i], NULL);
+        CuAssertIntEquals(tc, 0, readers[i].failures);
+    }
+    destroyBook(&book);
+    destroyEpochDomain(&domain);
+}
+
+static ReplayRecord
+makeReplayRecord(int type, uint64_t id, unsigned buyOrSell, int64_t price, int64_t shares){
+    ReplayRecord record;
+    memset(&record, 0, sizeof(record));
+    record.type = type;
+    record.id = id;
+    record.buyOrSell = buyOrSell;
+    record.price = price;
+    record.shares = shares;
+    return record;
+}
+
+void
+TestReplayFile(CuTest *tc){
+    /**
+     * Write a recorded feed to a file, replay it from the mapping, and assert the book and
+     * stats match the feed, that orders leaving the book go back to the pool, and that
+     * files which are not replay files are rejected.
+     */
+    ReplayRecord records[8];
+    records[0] = makeReplayRecord(EVENT_ADD, 1, BUY, 10000, 5);
+    records[1] = makeReplayRecord(EVENT_ADD, 2, BUY, 9999, 3);
+    records[2] = makeReplayRecord(EVENT_ADD, 3, SELL, 10002, 4);
+    records[3] = makeReplayRecord(EVENT_EXECUTE, 1, BUY, 0, 2);
+    records[4] = makeReplayRecord(EVENT_MODIFY, 3, SELL, 10001, 6);
+    records[5] = makeReplayRecord(EVENT_CANCEL, 2, BUY, 0, 0);
+    records[6] = makeReplayRecord(EVENT_CANCEL, 7, BUY, 0, 0);
+    records[7] = makeReplayRecord(EVENT_EXECUTE, 1, BUY, 0, 3);
+    char path[] = "/tmp/hftlobReplayXXXXXX";
+    int fd = mkstemp(path);
+    CuAssertTrue(tc, fd >= 0);
+    close(fd);
+    CuAssertIntEquals(tc, 1, writeReplayFile(path, records, 8));
+
+    ReplayFile file;
+    CuAssertIntEquals(tc, 1, openReplayFile(&file, path));
+    CuAssertIntEquals(tc, 8, file.count);
+    CuAssertIntEquals(tc, 3, countReplayAdds(&file));
+
+    Instrument instrument;
+    ReplayStats stats;
+    Book book;
+    initInstrument(&instrument, 0.01, 1);
+    initBook(&book);
+    CuAssertIntEquals(tc, 0, replayBook(&book, &instrument, &file, &stats));
+    CuAssertIntEquals(tc, 1, reserveOrders(&book, 16));
+    CuAssertIntEquals(tc, 1, reservePools(&book, 16, 16, 0));
+    CuAssertIntEquals(tc, 1, replayBook(&book, &instrument, &file, &stats));
+    CuAssertIntEquals(tc, 8, stats.messages);
+    CuAssertIntEquals(tc, 1, stats.failed);
+    CuAssertTrue(tc, getReplayLatency(&stats, 50) <= getReplayLatency(&stats, 100));
+    CuAssertTrue(tc, getReplayLatency(&stats, 100) == stats.maxLatencyNs);
+
+    CuAssertPtrEquals(tc, NULL, book.highestBuy);
+    CuAssertTrue(tc, book.lowestSell->limitPrice == toPrice(&instrument, 100.01));
+    CuAssertTrue(tc, book.lowestSell->size == toQuantity(&instrument, 6));
+    CuAssertIntEquals(tc, 1, book.orderPool.count);
+    CuAssertPtrEquals(tc, NULL, getOrderById(&book, 1));
+    destroyBook(&book);
+    closeReplayFile(&file);
+
+    FILE *out = fopen(path, "wb");
+    fputs("not a replay file, but long enough for a header", out);
+    fclose(out);
+    CuAssertIntEquals(tc, 0, openReplayFile(&file, path));
+    CuAssertTrue(tc, file.map == NULL);
+    unlink(path);
+    CuAssertIntEquals(tc, 0, openReplayFile(&file, path));
+}
+
+static size_t
+putItchMessage(uint8_t *buffer, char type, uint16_t locate, uint64_t reference, char side,
+               uint32_t shares, uint32_t price, uint64_t newReference){
+    ItchMessage message;
+    message.type = type;
+    message.stockLocate = locate;
+    message.timestamp = 0;
+    message.reference = reference;
+    message.newReference = newReference;
+    message.side = side;
+    message.shares = shares;
+    message.price = price;
+    return encodeItchMessage(&message, buffer);
+}
+
+void
+TestItchDecoder(CuTest *tc){
+    /**
+     * Decode each ITCH order message type into a lazy book, with the buffer split in the
+     * middle of a message, and assert the book ends up as the messages say. Then decode a
+     * generated sample file in one go and in small chunks and assert both books agree.
+     */
+    BookRegistry registry;
+    uint8_t buffer[16 * ITCH_MAX_FRAME];
+    size_t length = 0, messages = 0, failed = 0;
+    CuAssertIntEquals(tc, 1, initBookRegistry(&registry, 8));
+    CuAssertIntEquals(tc, 1, registerInstrument(&registry, 2, 0.01, 1, &ILLIQUID_TIER));
+
+    length += putItchMessage(buffer + length, ITCH_ADD, 2, 1, 'B', 300, 1000000, 0);
+    length += putItchMessage(buffer + length, ITCH_ADD_ATTRIBUTED, 2, 2, 'S', 200, 1000100, 0);
+    length += putItchMessage(buffer + length, ITCH_ADD, 2, 3, 'B', 100, 999900, 0);
+    length += putItchMessage(buffer + length, ITCH_EXECUTE, 2, 1, 0, 100, 0, 0);
+    length += putItchMessage(buffer + length, ITCH_CANCEL, 2, 1, 0, 50, 0, 0);
+    length += putItchMessage(buffer + length, ITCH_EXECUTE_WITH_PRICE, 2, 2, 0, 200, 1000000, 0);
+    length += putItchMessage(buffer + length, ITCH_REPLACE, 2, 3, 0, 400, 1000200, 4);
+    size_t split = length + 10;
+    length += putItchMessage(buffer + length, ITCH_ADD, 2, 5, 'S', 100, 1000300, 0);
+    length += putItchMessage(buffer + length, ITCH_DELETE, 2, 5, 0, 0, 0, 0);
+    /* A system event, which the decoder skips. */
+    uint8_t systemEvent[14] = {0, 12, 'S', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 'O'};
+    memcpy(buffer + length, systemEvent, sizeof(systemEvent));
+    length += sizeof(systemEvent);
+    length += putItchMessage(buffer + length, ITCH_DELETE, 2, 9, 0, 0, 0, 0);
+    length += putItchMessage(buffer + length, ITCH_DELETE, 3, 4, 0, 0, 0, 0);
+    CuAssertIntEquals(tc, 0, putItchMessage(buffer + length, 'S', 2, 0, 0, 0, 0, 0));
+
+    size_t consumed = decodeItchBuffer(&registry, buffer, split, &messages, &failed);
+    CuAssertTrue(tc, consumed < split);
+    CuAssertIntEquals(tc, 7, messages);
+    consumed += decodeItchBuffer(&registry, buffer + consumed, length - consumed, &messages, &failed);
+    CuAssertIntEquals(tc, length, consumed);
+    CuAssertIntEquals(tc, 12, messages);
+    CuAssertIntEquals(tc, 2, failed);
+
+    Book *book = getInstrumentBook(&registry, 2, 0);
+    Instrument *instrument = &registry.entries[2].instrument;
+    CuAssertPtrNotNull(tc, book);
+    CuAssertPtrEquals(tc, NULL, book->lowestSell);
+    CuAssertTrue(tc, book->highestBuy->limitPrice == toPrice(instrument, 100.02));
+    CuAssertTrue(tc, book->highestBuy->size == toQuantity(instrument, 400));
+    Limit *next = getNextBookLimit(book, book->highestBuy, BUY);
+    CuAssertTrue(tc, next->limitPrice == toPrice(instrument, 100.00));
+    CuAssertTrue(tc, next->size == toQuantity(instrument, 150));
+    CuAssertPtrEquals(tc, NULL, getOrderById(book, 3));
+    CuAssertPtrNotNull(tc, getOrderById(book, 4));
+    CuAssertIntEquals(tc, 2, book->orderPool.count);
+    destroyBookRegistry(&registry);
+
+    char path[] = "/tmp/hftlobItchXXXXXX";
+    int fd = mkstemp(path);
+    CuAssertTrue(tc, fd >= 0);
+    close(fd);
+    CuAssertIntEquals(tc, 1, writeItchSample(path, 1, 20000, 7));
+    BookRegistry fileRegistry, chunkRegistry;
+    CuAssertIntEquals(tc, 1, initBookRegistry(&fileRegistry, 2));
+    CuAssertIntEquals(tc, 1, initBookRegistry(&chunkRegistry, 2));
+    CuAssertIntEquals(tc, 1, registerInstrument(&fileRegistry, 1, 0.01, 1, &ACTIVE_TIER));
+    CuAssertIntEquals(tc, 1, registerInstrument(&chunkRegistry, 1, 0.01, 1, &ACTIVE_TIER));
+    messages = failed = 0;
+    CuAssertIntEquals(tc, 1, decodeItchFile(&fileRegistry, path, &messages, &failed));
+    CuAssertIntEquals(tc, 20000, messages);
+    CuAssertIntEquals(tc, 0, failed);
+
+    FILE *in = fopen(path, "rb");
+    size_t chunkMessages = 0, chunkFailed = 0, pending = 0, got;
+    while((got = fread(buffer + pending, 1, 97, in)) > 0){
+        pending += got;
+        consumed = decodeItchBuffer(&chunkRegistry, buffer, pending, &chunkMessages, &chunkFailed);
+        memmove(buffer, buffer + consumed, pending - consumed);
+        pending -= consumed;
+    }
+    fclose(in);
+    unlink(path);
+    CuAssertIntEquals(tc, 0, pending);
+    CuAssertIntEquals(tc, 20000, chunkMessages);
+    CuAssertIntEquals(tc, 0, chunkFailed);
+
+    TopOfBook fileTop, chunkTop;
+    getTopOfBook(getInstrumentBook(&fileRegistry, 1, 0), &fileTop);
+    getTopOfBook(getInstrumentBook(&chunkRegistry, 1, 0), &chunkTop);
+    CuAssertTrue(tc, fileTop.bidPrice == chunkTop.bidPrice && fileTop.bidSize == chunkTop.bidSize);
+    CuAssertTrue(tc, fileTop.askPrice == chunkTop.askPrice && fileTop.askSize == chunkTop.askSize);
+    CuAssertTrue(tc, fileTop.bidOrders > 0 && fileTop.askOrders > 0);
+    CuAssertIntEquals(tc, getInstrumentBook(&fileRegistry, 1, 0)->orderPool.count,
+                      getInstrumentBook(&chunkRegistry, 1, 0)->orderPool.count);
+    destroyBookRegistry(&fileRegistry);
+    destroyBookRegistry(&chunkRegistry);
+}
+
+static int
+applyJson(DepthFeed *feed, const char *json){
+    return applyDepthMessage(feed, json, strlen(json));
+}
+
+void
+TestJsonDepth(CuTest *tc){
+    /**
+     * Apply JSON depth messages of different layouts to an L2 book and assert the levels
+     * match, that decimal strings round to the tick and lot grid, that malformed messages
+     * leave the book alone, that large snapshots apply in chunks, that a stream of
+     * messages is applied line by line, and that levels get distinct order ids.
+     */
+    Book book;
+    DepthFeed feed;
+    initBook(&book);
+    CuAssertIntEquals(tc, 0, initDepthFeed(&feed, &book, 19, 0));
+    CuAssertIntEquals(tc, 1, initDepthFeed(&feed, &book, 2, 3));
+    Instrument *instrument = &feed.instrument;
+
+    CuAssertIntEquals(tc, 1, applyJson(&feed,
+        "{\"e\":\"depthUpdate\",\"E\":1,\"s\":\"BTCUSDT\",\"U\":1,\"u\":2,"
+        "\"b\":[[\"100.25\",\"1.5\"],[\"100.20\",\"2\"]],"
+        "\"a\":[[\"100.30\",\"0.75\"],[\"100.35\",\"3.0004\"]]}"));
+    CuAssertTrue(tc, book.highestBuy->limitPrice == toPrice(instrument, 100.25));
+    CuAssertTrue(tc, book.highestBuy->size == toQuantity(instrument, 1.5));
+    CuAssertTrue(tc, book.lowestSell->limitPrice == toPrice(instrument, 100.30));
+    Limit *ask = getNextBookLimit(&book, book.lowestSell, SELL);
+    CuAssertTrue(tc, ask->size == toQuantity(instrument, 3));
+
+    /* Nested in a stream wrapper, with extra entry fields and an escaped string. */
+    CuAssertIntEquals(tc, 1, applyJson(&feed,
+        " {\"arg\":{\"channel\":\"books\",\"note\":\"a \\\"b\\\" ]\"},\"action\":\"update\",\"data\":[{"
+        "\"asks\":[[\"100.30\",\"0\",\"0\",\"1\"]],"
+        "\"bids\":[[\"100.25\",\"2.25\",\"0\",\"3\"],[100.1,1],[\"100.155\",\"0.0005\"]],"
+        "\"ts\":\"1\",\"ok\":true,\"x\":null}]} "));
+    CuAssertTrue(tc, book.lowestSell->limitPrice == toPrice(instrument, 100.35));
+    CuAssertTrue(tc, book.highestBuy->size == toQuantity(instrument, 2.25));
+    Limit *bid = findBookLimit(&book, BUY, toPrice(instrument, 100.16));
+    CuAssertPtrNotNull(tc, bid);
+    CuAssertTrue(tc, bid->size == toQuantity(instrument, 0.001));
+    CuAssertPtrNotNull(tc, findBookLimit(&book, BUY, toPrice(instrument, 100.10)));
+    CuAssertIntEquals(tc, 5, book.orderPool.count);
+
+    /* Removing a missing level is fine; malformed messages change nothing. */
+    CuAssertIntEquals(tc, 1, applyJson(&feed, "{\"b\":[[\"99.00\",\"0\"]],\"a\":[]}"));
+    CuAssertIntEquals(tc, 0, applyJson(&feed, "{\"b\":[[\"1e3\",\"1\"]]}"));
+    CuAssertIntEquals(tc, 0, applyJson(&feed, "{\"b\":[[\"-1\",\"1\"]]}"));
+    CuAssertIntEquals(tc, 0, applyJson(&feed, "{\"b\":[[\"100.00\",\"1\"]]"));
+    CuAssertIntEquals(tc, 0, applyJson(&feed, "{\"b\":[[\"100.00\",\"1\"]]} x"));
+    CuAssertIntEquals(tc, 0, applyJson(&feed, "{\"b\":[[\"100.00\"]]}"));
+    CuAssertIntEquals(tc, 0, applyJson(&feed, "\"b\""));
+    CuAssertPtrEquals(tc, NULL, findBookLimit(&book, BUY, toPrice(instrument, 100.00)));
+    CuAssertIntEquals(tc, 5, book.orderPool.count);
+
+    /* A snapshot larger than the update buffer. */
+    char snapshot[16384];
+    int length = sprintf(snapshot, "{\"bids\":[");
+    int i;
+    for(i=0; i<600; i++){
+        length += sprintf(snapshot + length, "%s[\"%d.%02d\",\"1\"]", i > 0 ? "," : "", 90 - i / 100, 99 - i % 100);
+    }
+    sprintf(snapshot + length, "]}");
+    CuAssertIntEquals(tc, 1, applyJson(&feed, snapshot));
+    CuAssertIntEquals(tc, 605, book.orderPool.count);
+    CuAssertTrue(tc, findBookLimit(&book, BUY, toPrice(instrument, 85.00))->size == toQuantity(instrument, 1));
+
+    const char *stream = "{\"a\":[[\"100.35\",\"0\"]]}\n\n{\"b\":[[\"bad\",\"1\"]]}\r\n{\"a\":[[\"101.00\",\"1\"]]}";
+    size_t messages = 0, failed = 0;
+    size_t consumed = applyDepthStream(&feed, stream, strlen(stream), &messages, &failed);
+    CuAssertIntEquals(tc, 2, messages);
+    CuAssertIntEquals(tc, 1, failed);
+    CuAssertPtrEquals(tc, NULL, book.lowestSell);
+    CuAssertIntEquals(tc, 1, applyJson(&feed, stream + consumed));
+    CuAssertTrue(tc, book.lowestSell->limitPrice == toPrice(instrument, 101.00));
+    destroyBook(&book);
+
+    /* Levels of a book with an order id index each get their own id. */
+    initBook(&book);
+    CuAssertIntEquals(tc, 1, reserveOrders(&book, 64));
+    CuAssertIntEquals(tc, 1, initDepthFeed(&feed, &book, 2, 3));
+    CuAssertIntEquals(tc, 1, applyJson(&feed,
+        "{\"b\":[[\"100.25\",\"1\"],[\"100.20\",\"2\"]],\"a\":[[\"100.30\",\"3\"],[\"100.35\",\"4\"]]}"));
+    CuAssertIntEquals(tc, 4, book.orders.count);
+    Order *level = book.highestBuy->headOrder;
+    CuAssertPtrEquals(tc, level, getOrderById(&book, level->id));
+    CuAssertIntEquals(tc, 1, applyJson(&feed, "{\"b\":[[\"100.25\",\"0\"]],\"a\":[[\"100.30\",\"5\"]]}"));
+    CuAssertIntEquals(tc, 3, book.orders.count);
+    CuAssertTrue(tc, book.lowestSell->size == toQuantity(instrument, 5));
+    destroyBook(&book);
+}
 
 /**
  * Create Test Suite and test runner.
@@ -915,12 +3193,46 @@ CuSuite* HFTLobGetSuite(void){
     SUITE_ADD_TEST(suite, TestGetMinimumLimit);
     SUITE_ADD_TEST(suite, TestGetHeight);
     SUITE_ADD_TEST(suite, TestGetBalanceFactor);
+    SUITE_ADD_TEST(suite, TestHeightMaintenance);
     SUITE_ADD_TEST(suite, TestReplaceLimitInParent);
     SUITE_ADD_TEST(suite, TestRemoveLimit);
     SUITE_ADD_TEST(suite, TestRotateLL);
     SUITE_ADD_TEST(suite, TestRotateLR);
     SUITE_ADD_TEST(suite, TestRotateRR);
     SUITE_ADD_TEST(suite, TestRotateRL);
+    SUITE_ADD_TEST(suite, TestBalanceBranch);
+    SUITE_ADD_TEST(suite, TestBalancedInsert);
+    SUITE_ADD_TEST(suite, TestBalancedRemove);
+    SUITE_ADD_TEST(suite, TestBookAddOrder);
+    SUITE_ADD_TEST(suite, TestBookCancelOrder);
+    SUITE_ADD_TEST(suite, TestBookExecuteOrder);
+    SUITE_ADD_TEST(suite, TestBookModifyOrder);
+    SUITE_ADD_TEST(suite, TestOrderMap);
+    SUITE_ADD_TEST(suite, TestTidMap);
+    SUITE_ADD_TEST(suite, TestBookOrdersById);
+    SUITE_ADD_TEST(suite, TestInstrumentConversions);
+    SUITE_ADD_TEST(suite, TestBitmap);
+    SUITE_ADD_TEST(suite, TestSubmitOrder);
+    SUITE_ADD_TEST(suite, TestSubmitOrderTypes);
+    SUITE_ADD_TEST(suite, TestGetNextBookLimit);
+    SUITE_ADD_TEST(suite, TestLadderOffGridPrices);
+    SUITE_ADD_TEST(suite, TestApplyEvents);
+    SUITE_ADD_TEST(suite, TestPool);
+    SUITE_ADD_TEST(suite, TestBookPools);
+    SUITE_ADD_TEST(suite, TestOrderHandles);
+    SUITE_ADD_TEST(suite, TestLadderBook);
+    SUITE_ADD_TEST(suite, TestLadderBookMatchesTreeBook);
+    SUITE_ADD_TEST(suite, TestBookSizeBetween);
+    SUITE_ADD_TEST(suite, TestQueuePosition);
+    SUITE_ADD_TEST(suite, TestBookDepth);
+    SUITE_ADD_TEST(suite, TestBookRegistry);
+    SUITE_ADD_TEST(suite, TestSpscRing);
+    SUITE_ADD_TEST(suite, TestEngine);
+    SUITE_ADD_TEST(suite, TestBookSnapshot);
+    SUITE_ADD_TEST(suite, TestEpochReclamation);
+    SUITE_ADD_TEST(suite, TestReplayFile);
+    SUITE_ADD_TEST(suite, TestItchDecoder);
+    SUITE_ADD_TEST(suite, TestJsonDepth);
 
     return suite;
 }
@@ -14,16 +14,23 @@ by being more descriptive.
 
 void
 initOrder(Order *order){
-    order->tid = NULL;
+    order->id = 0;
     order->buyOrSell = -1;
     order->shares = 0;
     order->limit = 0;
-    order->entryTime = 0;
-    order->eventTime = 0;
     order->nextOrder = NULL;
     order->prevOrder = NULL;
     order->parentLimit = NULL;
-    order->exchangeId = 0;
+    order->queueRank = 0;
+    order->fromEvent = 0;
+};
+
+void
+initOrderMeta(OrderMeta *meta){
+    meta->tid = NULL;
+    meta->entryTime = 0;
+    meta->eventTime = 0;
+    meta->exchangeId = 0;
 };
 
 void
@@ -32,11 +39,53 @@ initLimit(Limit *limit){
     limit->size = 0;
     limit->totalVolume = 0;
     limit->orderCount = 0;
+    limit->height = 0;
+    limit->subtreeSize = 0;
+    limit->subtreeVolume = 0;
+    limit->queueIndex = NULL;
     limit->parent = NULL;
     limit->leftChild = NULL;
     limit->rightChild = NULL;
+    limit->nextLimit = NULL;
+    limit->prevLimit = NULL;
     limit->headOrder = NULL;
-    limit->headOrder = NULL;
+    limit->tailOrder = NULL;
+};
+
+int
+initBook(Book *book){
+    /**
+     * Initialise an empty book. Return 0 if its roots cannot be allocated;
+     * the book then holds nothing, and destroyBook() is a no-op on it.
+     */
+    initPool(&book->limitPool, sizeof(Limit), 0, 0);
+    initPool(&book->orderPool, sizeof(Order), 0, POOL_CACHE_ALIGNED | POOL_HANDLES);
+    book->buyTree = createPooledRoot(&book->limitPool);
+    book->sellTree = createPooledRoot(&book->limitPool);
+    book->lowestSell = NULL;
+    book->highestBuy = NULL;
+    book->orders.slots = NULL;
+    book->orders.capacity = 0;
+    book->orders.count = 0;
+    book->orders.maxCount = 0;
+    book->buyLadder = NULL;
+    book->sellLadder = NULL;
+    book->orderMeta = NULL;
+    book->orderMetaCapacity = 0;
+    book->buyDepth.levels = NULL;
+    book->buyDepth.capacity = 0;
+    book->buyDepth.count = 0;
+    book->sellDepth = book->buyDepth;
+    book->snapshot = NULL;
+    book->epochs = NULL;
+    book->rangeTotals = 0;
+    if(book->buyTree == NULL || book->sellTree == NULL){
+        destroyPool(&book->limitPool);
+        book->buyTree = NULL;
+        book->sellTree = NULL;
+        return 0;
+    }
+    return 1;
 };
 
 void
@@ -50,6 +99,7 @@ initQueue(Queue *q){
     q->head = NULL;
     q->tail = NULL;
     q->size = 0;
+    q->itemPool = NULL;
 };
 
 int
@@ -82,6 +132,27 @@ limitExists(Limit *root, Limit *limit){
     return 1;
 }
 
+Limit*
+findLimit(Limit *root, Price price){
+    /**
+     * Return the limit struct with the given price from the given
+     * limit tree, or NULL if there is no such limit.
+     */
+    Limit *currentLimit = root->rightChild;
+    while(currentLimit != NULL){
+        if(currentLimit->limitPrice < price){
+            currentLimit = currentLimit->rightChild;
+        }
+        else if(currentLimit->limitPrice > price){
+            currentLimit = currentLimit->leftChild;
+        }
+        else{
+            return currentLimit;
+        }
+    }
+    return NULL;
+}
+
 int
 limitIsRoot(Limit *limit){
     /**
@@ -152,42 +223,133 @@ getMaximumLimit(Limit *limit){
     return (ptr_maximum);
 }
 
+Limit*
+getSuccessor(Limit *limit){
+    /**
+     * Return the limit with the next higher price in the limit's tree,
+     * or NULL if it is the highest. For the root, return the lowest limit.
+     *
+     * O(1), following the limits' in-order links.
+     */
+    Limit *next = limit->nextLimit;
+    if(next == NULL || limitIsRoot(next)){
+        return NULL;
+    }
+    return next;
+}
+
+Limit*
+getPredecessor(Limit *limit){
+    /**
+     * Return the limit with the next lower price in the limit's tree,
+     * or NULL if it is the lowest. For the root, return the highest limit.
+     *
+     * O(1), following the limits' in-order links.
+     */
+    Limit *prev = limit->prevLimit;
+    if(prev == NULL || limitIsRoot(prev)){
+        return NULL;
+    }
+    return prev;
+}
+
 int
 getHeight(Limit *limit){
     /**
-     * Calculate the height of the limits under the passed limit non-recursively.
+     * Return the height of the limits under the passed limit.
+     *
+     * The height is cached in the limit and kept up to date by the tree
+     * operations, so this is O(1).
      */
-
-     if(limit == NULL){
+    if(limit == NULL){
         return -1;
-     }
-
-    int height = -1; /*Set to -1; if limit has no children, this will end up being 0*/
-    int qsize = 0;
-
-    Queue *ptr_queue = malloc(sizeof(Queue));
-    initQueue(ptr_queue);
-    Limit *ptr_current;
-    pushToQueue(ptr_queue, limit);
-    while(1){
-        qsize = ptr_queue->size;
-        if(qsize == 0){
+    }
+    return limit->height;
+}
+
+void
+updateHeight(Limit *limit){
+    /**
+     * Recalculate the cached height of the passed limit from the
+     * cached heights of its children.
+     */
+    int leftHeight = getHeight(limit->leftChild);
+    int rightHeight = getHeight(limit->rightChild);
+    limit->height = 1 + (leftHeight > rightHeight ? leftHeight : rightHeight);
+}
+
+void
+updateSubtreeTotals(Limit *limit){
+    /**
+     * Recalculate the size and volume of all limits under the passed
+     * limit, including itself, from the totals of its children.
+     */
+    limit->subtreeSize = limit->size;
+    limit->subtreeVolume = limit->totalVolume;
+    if(limit->leftChild != NULL){
+        limit->subtreeSize += limit->leftChild->subtreeSize;
+        limit->subtreeVolume += limit->leftChild->subtreeVolume;
+    }
+    if(limit->rightChild != NULL){
+        limit->subtreeSize += limit->rightChild->subtreeSize;
+        limit->subtreeVolume += limit->rightChild->subtreeVolume;
+    }
+}
+
+void
+rebuildSubtreeTotals(Limit *limit){
+    /**
+     * Recalculate the subtree totals of the passed limit and all limits
+     * under it from their sizes.
+     */
+    if(limit == NULL){
+        return;
+    }
+    rebuildSubtreeTotals(limit->leftChild);
+    rebuildSubtreeTotals(limit->rightChild);
+    updateSubtreeTotals(limit);
+}
+
+void
+retraceSubtreeTotals(Limit *limit){
+    /**
+     * Recalculate the subtree totals from the passed limit up to the root,
+     * after the tree below it changed shape.
+     */
+    while(limit != NULL){
+        updateSubtreeTotals(limit);
+        limit = limit->parent;
+    }
+}
+
+void
+adjustSubtreeTotals(Limit *limit, Quantity size, Volume volume){
+    /**
+     * Add a change of a limit's size and volume to its subtree totals and
+     * those of all limits above it.
+     */
+    while(limit != NULL){
+        limit->subtreeSize += size;
+        limit->subtreeVolume += volume;
+        limit = limit->parent;
+    }
+}
+
+void
+retraceHeight(Limit *limit){
+    /**
+     * Update the cached heights from the passed limit up to the root,
+     * stopping early once a height does not change.
+     */
+    int oldHeight;
+    while(limit != NULL){
+        oldHeight = limit->height;
+        updateHeight(limit);
+        if(limit->height == oldHeight){
             break;
         }
-        height++;
-        while(qsize > 0){
-            ptr_current = popFromQueue(ptr_queue);
-            if(ptr_current->leftChild != NULL){
-                pushToQueue(ptr_queue, ptr_current->leftChild);
-            }
-            if(ptr_current->rightChild != NULL){
-                pushToQueue(ptr_queue, ptr_current->rightChild);
-            }
-            qsize--;
-        }
+        limit = limit->parent;
     }
-    free(ptr_queue);
-    return height;
 }
 
 int
@@ -217,6 +379,9 @@ copyLimit(Limit *ptr_src, Limit *ptr_tar){
     ptr_tar->limitPrice = ptr_src->limitPrice;
     ptr_tar->size = ptr_src->size;
     ptr_tar->totalVolume = ptr_src->totalVolume;
+    ptr_tar->subtreeSize = ptr_src->size;
+    ptr_tar->subtreeVolume = ptr_src->totalVolume;
+    ptr_tar->queueIndex = ptr_src->queueIndex;
     ptr_tar->orderCount = ptr_src->orderCount;
     ptr_tar->headOrder = ptr_src->headOrder;
     ptr_tar->tailOrder = ptr_src->tailOrder;